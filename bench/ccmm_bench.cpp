@@ -0,0 +1,402 @@
+// Benchmarks for the kernels of the CCMM solver and for the end-to-end
+// clusterpath and clustering runs. The data are Gaussian blobs or two half
+// moons, generated for each combination of the number of objects n, the
+// number of variables p, and the number of nearest neighbors k used for the
+// weights. The results are written to standard output as JSON
+//
+// Usage: ccmmr_bench [--n 1000,4000] [--p 2,10] [--k 5,15]
+//                    [--data blobs,moons] [--reps 5] [--threads 1]
+//                    [--seed 1]
+#include <CCMMR.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+struct BenchSettings {
+    std::vector<int> n = {1000, 4000};
+    std::vector<int> p = {2, 10};
+    std::vector<int> k = {5, 15};
+    std::vector<std::string> data = {"blobs", "moons"};
+    int reps = 5;
+    int n_threads = 1;
+    unsigned seed = 1;
+
+    // Settings of the solver, equal to the defaults of the R package
+    double phi = 8.0;
+    double tau = 1e-3;
+    double eps_conv = 1e-6;
+    int burnin_iter = 25;
+    int max_iter_conv = 5000;
+};
+
+
+struct BenchCase {
+    std::string data;
+    int n;
+    int p;
+    int k;
+};
+
+
+std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> result;
+    std::stringstream stream(list);
+    std::string item;
+
+    while (std::getline(stream, item, ',')) {
+        result.push_back(item);
+    }
+
+    return result;
+}
+
+
+std::vector<int> split_int(const std::string& list)
+{
+    std::vector<int> result;
+
+    for (const std::string& item : split(list)) {
+        result.push_back(std::atoi(item.c_str()));
+    }
+
+    return result;
+}
+
+
+// Center the variables, the objects are in the columns of X
+void center(Eigen::MatrixXd& X)
+{
+    Eigen::VectorXd mean = X.rowwise().mean();
+    X.colwise() -= mean;
+}
+
+
+// Five Gaussian blobs with unit variance and centers drawn uniformly from
+// [-10, 10]^p
+Eigen::MatrixXd make_blobs(int n, int p, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(-10.0, 10.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    Eigen::MatrixXd centers(p, 5);
+    for (int j = 0; j < 5; j++) {
+        for (int i = 0; i < p; i++) {
+            centers(i, j) = uniform(gen);
+        }
+    }
+
+    Eigen::MatrixXd X(p, n);
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < p; i++) {
+            X(i, j) = centers(i, j % 5) + normal(gen);
+        }
+    }
+
+    center(X);
+
+    return X;
+}
+
+
+// Two interleaving half moons in the first two variables, like the
+// two_half_moons data in the package but with n objects. Further variables
+// contain noise only
+Eigen::MatrixXd make_moons(int n, int p, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> uniform(0.0, std::acos(-1.0));
+    std::normal_distribution<double> normal(0.0, 0.1);
+
+    Eigen::MatrixXd X(p, n);
+    for (int j = 0; j < n; j++) {
+        double t = uniform(gen);
+        double x = j % 2 == 0 ? std::cos(t) : 1 - std::cos(t);
+        double y = j % 2 == 0 ? std::sin(t) : 0.5 - std::sin(t);
+
+        for (int i = 0; i < p; i++) {
+            X(i, j) = (i == 0 ? x : i == 1 ? y : 0) + normal(gen);
+        }
+    }
+
+    center(X);
+
+    return X;
+}
+
+
+// Lower triangular part of the weight matrix from the key value pairs, which
+// contain duplicates
+Eigen::SparseMatrix<double> weight_matrix(const CCMMWeights& weights, int n)
+{
+    std::set<std::pair<int, int>> seen;
+    std::vector<Eigen::Triplet<double>> triplets;
+
+    for (int i = 0; i < weights.keys.cols(); i++) {
+        int a = std::max(weights.keys(0, i), weights.keys(1, i));
+        int b = std::min(weights.keys(0, i), weights.keys(1, i));
+
+        if (seen.insert({a, b}).second) {
+            triplets.emplace_back(a, b, weights.values(i));
+        }
+    }
+
+    Eigen::SparseMatrix<double> W(n, n);
+    W.setFromTriplets(triplets.begin(), triplets.end());
+
+    return W;
+}
+
+
+// Time a function reps times and write the result as a JSON object
+void time_function(const std::string& name, const BenchCase& bench_case,
+                   const BenchSettings& settings, int reps,
+                   const std::function<void()>& setup,
+                   const std::function<void()>& f, bool& first)
+{
+    std::vector<double> seconds(reps);
+
+    for (int r = 0; r < reps; r++) {
+        setup();
+
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto stop = std::chrono::steady_clock::now();
+
+        seconds[r] = std::chrono::duration<double>(stop - start).count();
+    }
+
+    double mean = 0;
+    for (double s : seconds) mean += s;
+    mean /= reps;
+
+    std::printf("%s    {\"name\": \"%s\", \"data\": \"%s\", \"n\": %d, "
+                "\"p\": %d, \"k\": %d, \"threads\": %d, \"reps\": %d, "
+                "\"mean_seconds\": %.9g, \"min_seconds\": %.9g}",
+                first ? "" : ",\n", name.c_str(), bench_case.data.c_str(),
+                bench_case.n, bench_case.p, bench_case.k, settings.n_threads,
+                reps, mean, *std::min_element(seconds.begin(), seconds.end()));
+    std::fflush(stdout);
+
+    first = false;
+}
+
+
+void run_case(const BenchCase& bench_case, const BenchSettings& settings,
+              bool& first)
+{
+    int n = bench_case.n;
+    int reps = settings.reps;
+    const BenchCase& c = bench_case;
+    auto none = []() {};
+
+    Eigen::MatrixXd X = bench_case.data == "moons" ?
+        make_moons(n, bench_case.p, settings.seed) :
+        make_blobs(n, bench_case.p, settings.seed);
+
+    // Nearest neighbors and weights, the k + 1 nearest neighbors include each
+    // object itself
+    Eigen::MatrixXi indices;
+    Eigen::MatrixXd distances;
+    time_function("knn_kdtree", c, settings, reps, none, [&]() {
+        KDTree tree(X, 16, settings.n_threads);
+        tree.query(bench_case.k + 1, indices, distances, settings.n_threads);
+    }, first);
+
+    CCMMWeights weights;
+    time_function("sparse_weights", c, settings, reps, none, [&]() {
+        weights = knn_weights(X, indices, distances, settings.phi,
+                              bench_case.k, true, true, settings.n_threads);
+    }, first);
+
+    time_function("sparse_weights_native", c, settings, reps, none, [&]() {
+        static_cast<void>(native_knn_weights(X, settings.phi, bench_case.k,
+                                             true, true, settings.n_threads));
+    }, first);
+
+    // Minimum spanning tree between the components of the nearest neighbor
+    // graph without the symmetric circulant edges
+    CCMMWeights knn_only = knn_weights(X, indices, distances, settings.phi,
+                                       bench_case.k, false, true,
+                                       settings.n_threads);
+    time_function("connect_components", c, settings, reps, none, [&]() {
+        Eigen::MatrixXi edges;
+        Eigen::VectorXd edge_distances;
+        connect_components(X, knn_only.keys, edges, edge_distances,
+                           settings.n_threads);
+    }, first);
+
+    Eigen::SparseMatrix<double> W = weight_matrix(weights, n);
+
+    // Minimum spanning tree of the complete graph, skipped for large n as the
+    // dense distance matrix is quadratic in n
+    if (n <= 4000) {
+        Eigen::MatrixXd G(n, n);
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                G(i, j) = (X.col(i) - X.col(j)).norm();
+            }
+        }
+
+        time_function("find_mst", c, settings, reps, none, [&]() {
+            static_cast<void>(minimum_spanning_tree(G));
+        }, first);
+    }
+
+    // Minimum spanning forest of the nearest neighbor graph
+    Eigen::VectorXd lengths(knn_only.keys.cols());
+    for (int i = 0; i < knn_only.keys.cols(); i++) {
+        lengths(i) = (X.col(knn_only.keys(0, i)) -
+                      X.col(knn_only.keys(1, i))).norm();
+    }
+
+    time_function("find_mst_sparse", c, settings, reps, none, [&]() {
+        static_cast<void>(minimum_spanning_tree(knn_only.keys, lengths, n));
+    }, first);
+
+    // Fusion threshold, by the chunked exact method and by sampling as in the
+    // package default
+    time_function("median_dist", c, settings, reps, none, [&]() {
+        static_cast<void>(median_dist(X));
+    }, first);
+
+    double eps_fusions = 0;
+    time_function("sampled_median_dist", c, settings, reps, none, [&]() {
+        eps_fusions = settings.tau * sampled_median_dist(
+            X, 0.005, settings.seed, settings.n_threads
+        );
+    }, first);
+
+    CCMMConstants constants(X, W, settings.eps_conv, eps_fusions,
+                            settings.burnin_iter, settings.max_iter_conv, true,
+                            false, settings.n_threads, ACCELERATION_DOUBLING, 5);
+
+    // Find the range of lambda over which the clustering changes by searching
+    // for two clusters
+    CCMMResults clustering = ccmm_clustering(
+        X, W, settings.eps_conv, eps_fusions, true, false, settings.burnin_iter,
+        settings.max_iter_conv, 2, 2, 2000, 20, 0, 0.01, 0.025,
+        settings.n_threads, ACCELERATION_DOUBLING, 5, 1, CCMMHooks()
+    );
+    double lambda_max = clustering.targets_found > 0 ?
+        clustering.info_d(0, 0) : 1.0;
+
+    // Kernels, evaluated at the start of the path and at a lambda halfway
+    CCMMVariables<> variables_init(X, W);
+    CCMMVariables<> variables = variables_init;
+    double lambda = 0.5 * lambda_max;
+
+    time_function("update_distances", c, settings, reps, none, [&]() {
+        variables.update_distances(settings.n_threads);
+    }, first);
+
+    time_function("loss_fusions", c, settings, reps, none, [&]() {
+        static_cast<void>(variables.loss_fusions(constants, lambda));
+    }, first);
+
+    time_function("update", c, settings, reps, none, [&]() {
+        variables.update(constants, lambda, 0);
+    }, first);
+
+    // Fuse the clusters of the solution halfway, using the median distance
+    // between connected clusters as threshold to force fusions
+    CCMMVariables<> variables_mid = variables_init;
+    static_cast<void>(variables_mid.minimize(constants, lambda, -1.0, false));
+
+    Eigen::ArrayXd edge_distances = variables_mid.distances;
+    double eps_fuse = 0;
+    if (edge_distances.size() > 0) {
+        std::nth_element(edge_distances.data(),
+                         edge_distances.data() + edge_distances.size() / 2,
+                         edge_distances.data() + edge_distances.size());
+        eps_fuse = edge_distances(edge_distances.size() / 2);
+    }
+
+    time_function("fuse", c, settings, reps, [&]() {
+        variables = variables_mid;
+    }, [&]() {
+        static_cast<void>(variables.fuse(eps_fuse, lambda, settings.n_threads));
+    }, first);
+
+    // End-to-end runs
+    Eigen::VectorXd lambdas = Eigen::VectorXd::LinSpaced(100, 0, lambda_max);
+    Eigen::VectorXd target_losses = Eigen::VectorXd::Constant(100, -1);
+
+    time_function("convex_clusterpath", c, settings, reps, none, [&]() {
+        static_cast<void>(ccmm_clusterpath(
+            X, W, lambdas, target_losses, settings.eps_conv, eps_fusions, true,
+            false, false, false, false, settings.burnin_iter,
+            settings.max_iter_conv, settings.n_threads, ACCELERATION_DOUBLING,
+            5, nullptr, CCMMHooks()
+        ));
+    }, first);
+
+    time_function("convex_clustering", c, settings, reps, none, [&]() {
+        static_cast<void>(ccmm_clustering(
+            X, W, settings.eps_conv, eps_fusions, true, false,
+            settings.burnin_iter, settings.max_iter_conv, 2, 10, 2000, 20, 0,
+            0.01, 0.025, settings.n_threads, ACCELERATION_DOUBLING, 5, 1,
+            CCMMHooks()
+        ));
+    }, first);
+}
+
+
+int main(int argc, char** argv)
+{
+    BenchSettings settings;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+
+        if (option == "--n") {
+            settings.n = split_int(value);
+        } else if (option == "--p") {
+            settings.p = split_int(value);
+        } else if (option == "--k") {
+            settings.k = split_int(value);
+        } else if (option == "--data") {
+            settings.data = split(value);
+        } else if (option == "--reps") {
+            settings.reps = std::max(1, std::atoi(value.c_str()));
+        } else if (option == "--threads") {
+            settings.n_threads = std::max(1, std::atoi(value.c_str()));
+        } else if (option == "--seed") {
+            settings.seed = unsigned(std::atoi(value.c_str()));
+        } else {
+            std::cerr << "Unknown option " << option << '\n';
+            return 1;
+        }
+    }
+
+    bool first = true;
+    std::printf("{\n  \"benchmarks\": [\n");
+
+    for (const std::string& data : settings.data) {
+        for (int n : settings.n) {
+            for (int p : settings.p) {
+                for (int k : settings.k) {
+                    if (k >= n) continue;
+                    run_case({data, n, p, k}, settings, first);
+                }
+            }
+        }
+    }
+
+    std::printf("\n  ]\n}\n");
+
+    return 0;
+}
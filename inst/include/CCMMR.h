@@ -0,0 +1,19 @@
+#ifndef CCMMR_H
+#define CCMMR_H
+
+// Convex clustering through MM. The solver core only depends on Eigen, hosts
+// such as the R package pass their interrupt and logging hooks through
+// CCMMHooks
+#include "ccmmr/hooks.h"
+#include "ccmmr/disjoint_set.h"
+#include "ccmmr/graphs.h"
+#include "ccmmr/knn.h"
+#include "ccmmr/weights.h"
+#include "ccmmr/median_dist.h"
+#include "ccmmr/instrumentation.h"
+#include "ccmmr/storage.h"
+#include "ccmmr/solver.h"
+#include "ccmmr/sink.h"
+#include "ccmmr/path.h"
+
+#endif // CCMMR_H
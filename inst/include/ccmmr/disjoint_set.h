@@ -0,0 +1,123 @@
+#ifndef CCMMR_DISJOINT_SET_H
+#define CCMMR_DISJOINT_SET_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+struct DisjointSet {
+    std::vector<int> id;
+    std::vector<int> sz;
+
+    DisjointSet(int N)
+    {
+        // Set the id of each object to itself and set the sizes to one
+        id.resize(N);
+        sz.resize(N);
+
+        for (int i = 0; i < N; i++) {
+            id[i] = i;
+            sz[i] = 1;
+        }
+    }
+
+    int root(int i)
+    {
+        // Ascend through the tree until the root is found and apply path
+        // compression on the way up
+        while(i != id[i]) {
+            id[i] = id[id[i]];
+            i = id[i];
+        }
+
+        return i;
+    }
+
+    bool connected(int p, int q)
+    {
+        // Check if p and q have the same root
+        return root(p) == root(q);
+    }
+
+    void merge(int p, int q)
+    {
+        // Change the parent of the root of p into the root of q
+        int i = root(p);
+        int j = root(q);
+
+        // Return if the roots are the same
+        if (i == j) return;
+
+        // Otherwise link the root of the smaller tree to the root of the larger
+        // tree
+        if (sz[i] < sz[j]) {
+            id[i] = j;
+            sz[j] += sz[i];
+        } else {
+            id[j] = i;
+            sz[i] += sz[j];
+        }
+    }
+};
+
+// Disjoint set that allows concurrent calls of root and merge. The parents are
+// atomic: merge links the root with the larger index to the root with the
+// smaller index by a compare-and-swap and retries if another thread changed
+// that root in the meantime, root applies path halving by compare-and-swap.
+// Because links always point to smaller indices, the root of each set is its
+// smallest element
+struct ConcurrentDisjointSet {
+    std::unique_ptr<std::atomic<int>[]> id;
+
+    ConcurrentDisjointSet(int N) : id(new std::atomic<int>[N])
+    {
+        for (int i = 0; i < N; i++) {
+            id[i].store(i, std::memory_order_relaxed);
+        }
+    }
+
+    int root(int i)
+    {
+        while (true) {
+            int parent = id[i].load(std::memory_order_relaxed);
+            if (parent == i) return i;
+
+            // Point i to its grandparent, failure means that another thread
+            // already moved it up the tree
+            int grandparent = id[parent].load(std::memory_order_relaxed);
+            if (parent != grandparent) {
+                id[i].compare_exchange_weak(parent, grandparent,
+                                            std::memory_order_relaxed);
+            }
+
+            i = grandparent;
+        }
+    }
+
+    bool connected(int p, int q)
+    {
+        return root(p) == root(q);
+    }
+
+    void merge(int p, int q)
+    {
+        while (true) {
+            int i = root(p);
+            int j = root(q);
+
+            if (i == j) return;
+            if (i < j) std::swap(i, j);
+
+            // Link i to j if i is still a root
+            int expected = i;
+            if (id[i].compare_exchange_strong(expected, j)) return;
+
+            p = i;
+            q = j;
+        }
+    }
+};
+
+#endif // CCMMR_DISJOINT_SET_H
@@ -0,0 +1,398 @@
+#ifndef CCMMR_GRAPHS_H
+#define CCMMR_GRAPHS_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <vector>
+#include "disjoint_set.h"
+#include "knn.h"
+
+
+// Weighted edges of a graph. The vertices are int, the edges are counted and
+// sorted with Index, which has to hold the number of edges
+template <typename Index = int>
+struct Edges {
+    std::vector<int> a;
+    std::vector<int> b;
+    std::vector<double> w;
+
+    // Edges of the graph with weights G, where a weight that is not finite
+    // means that there is no edge
+    Edges(const Eigen::MatrixXd& G)
+    {
+        // Number of edges
+        Index n = 0;
+
+        for (int j = 0; j < G.cols(); j++) {
+            for (int i = 0; i < j; i++) {
+                n += std::isfinite(G(i, j));
+            }
+        }
+
+        a.resize(n);
+        b.resize(n);
+        w.resize(n);
+
+        Index index = 0;
+
+        for (int j = 0; j < G.cols(); j++) {
+            for (int i = 0; i < j; i++) {
+                if (!std::isfinite(G(i, j))) continue;
+
+                a[index] = i;
+                b[index] = j;
+                w[index] = G(i, j);
+
+                index++;
+            }
+        }
+    }
+
+    // Edges in the columns of E with weights w
+    Edges(const Eigen::MatrixXi& E, const Eigen::VectorXd& weights)
+    {
+        Index n = Index(E.cols());
+
+        a.resize(n);
+        b.resize(n);
+        w.resize(n);
+
+        for (Index i = 0; i < n; i++) {
+            a[i] = E(0, i);
+            b[i] = E(1, i);
+            w[i] = weights(i);
+        }
+    }
+
+    void sort()
+    {
+        Index n = Index(a.size());
+
+        // Vector of indices
+        std::vector<Index> indices(n);
+        for (Index i = 0; i < n; i++) indices[i] = i;
+
+        // Sort based on the weights, ties are broken by the original order
+        std::sort(
+            indices.begin(), indices.end(),
+            [&](Index i, Index j) {
+                return w[i] < w[j] || (w[i] == w[j] && i < j);
+            }
+        );
+
+        // New versions of a, b, and w
+        std::vector<int> a_new(n);
+        std::vector<int> b_new(n);
+        std::vector<double> w_new(n);
+
+        for (Index i = 0; i < n; i++) {
+            a_new[i] = a[indices[i]];
+            b_new[i] = b[indices[i]];
+            w_new[i] = w[indices[i]];
+        }
+
+        // Assign
+        a = std::move(a_new);
+        b = std::move(b_new);
+        w = std::move(w_new);
+    }
+
+    Index size() const
+    {
+        return Index(a.size());
+    }
+
+    int u(Index index) const
+    {
+        return a[index];
+    }
+
+    int v(Index index) const
+    {
+        return b[index];
+    }
+};
+
+
+// Minimum spanning forest of the graph with n vertices and edges E using
+// Kruskal's algorithm, returned as a matrix of edges with one row per edge
+template <typename Index>
+Eigen::MatrixXi minimum_spanning_tree_kruskal(Edges<Index>& E, int n)
+{
+    // Initialize a disjoint set
+    DisjointSet djs(n);
+
+    // Sort the edges based on their weights
+    E.sort();
+
+    // Initialize minimum spanning tree as a matrix of integers, a spanning
+    // forest has fewer edges
+    Eigen::MatrixXi mst(2, std::max(n - 1, 0));
+    int mst_index = 0;
+
+    // Apply the remainder of Kruskal's algorithm, adding edges with the
+    // smallest weight unless they cause a loop
+    for (Index i = 0; i < E.size() && mst_index < n - 1; i++) {
+        if (!djs.connected(E.u(i), E.v(i))) {
+            mst(0, mst_index) = E.u(i);
+            mst(1, mst_index) = E.v(i);
+            mst_index++;
+
+            djs.merge(E.u(i), E.v(i));
+        }
+    }
+
+    return mst.leftCols(mst_index).transpose();
+}
+
+
+// Minimum spanning forest of the graph with weights G using Prim's algorithm,
+// which takes O(n^2) time and O(n) memory. A weight that is not finite means
+// that there is no edge. The edges are returned as rows (i, j) with i < j in
+// the order in which they are added
+inline Eigen::MatrixXi minimum_spanning_tree_prim(const Eigen::MatrixXd& G)
+{
+    int n = int(G.cols());
+    double inf = std::numeric_limits<double>::infinity();
+
+    // Weight of the lightest edge between each vertex and the tree, and the
+    // vertex in the tree at the other end of that edge
+    std::vector<double> key(n, inf);
+    std::vector<int> parent(n, -1);
+    std::vector<bool> in_tree(n, false);
+
+    Eigen::MatrixXi mst(2, std::max(n - 1, 0));
+    int mst_index = 0;
+
+    for (int step = 0; step < n; step++) {
+        // Vertex closest to the tree, if no vertex is connected to the tree a
+        // new tree of the forest is started
+        int v = -1;
+
+        for (int i = 0; i < n; i++) {
+            if (!in_tree[i] && (v < 0 || key[i] < key[v])) v = i;
+        }
+
+        in_tree[v] = true;
+
+        if (parent[v] >= 0) {
+            mst(0, mst_index) = std::min(v, parent[v]);
+            mst(1, mst_index) = std::max(v, parent[v]);
+            mst_index++;
+        }
+
+        // Update the keys of the remaining vertices, column v holds the
+        // weights of the edges of v
+        for (int i = 0; i < n; i++) {
+            if (!in_tree[i] && G(i, v) < key[i]) {
+                key[i] = G(i, v);
+                parent[i] = v;
+            }
+        }
+    }
+
+    return mst.leftCols(mst_index).transpose();
+}
+
+
+// Minimum spanning forest of the graph with weights G, where a weight that is
+// not finite means that there is no edge. Prim's algorithm is used unless the
+// graph is so sparse that sorting its edges is cheaper than O(n^2)
+inline Eigen::MatrixXi minimum_spanning_tree(const Eigen::MatrixXd& G)
+{
+    Eigen::Index n = G.cols();
+
+    // Number of edges
+    Eigen::Index m = 0;
+
+    for (Eigen::Index j = 0; j < n; j++) {
+        for (Eigen::Index i = 0; i < j; i++) {
+            m += std::isfinite(G(i, j));
+        }
+    }
+
+    if (m < 2 || double(m) * std::log2(double(m)) >= double(n) * double(n)) {
+        return minimum_spanning_tree_prim(G);
+    }
+
+    // The edges are indexed with 32-bit integers unless there are too many
+    // of them
+    if (m > std::numeric_limits<int>::max()) {
+        Edges<std::int64_t> E(G);
+        return minimum_spanning_tree_kruskal(E, int(n));
+    }
+
+    Edges<int> E(G);
+    return minimum_spanning_tree_kruskal(E, int(n));
+}
+
+
+// Minimum spanning forest of the graph with n vertices and the edges in the
+// columns of E with weights w, such as a nearest neighbor graph
+inline Eigen::MatrixXi minimum_spanning_tree(const Eigen::MatrixXi& E,
+                                             const Eigen::VectorXd& w, int n)
+{
+    Edges<Eigen::Index> edges(E, w);
+    return minimum_spanning_tree_kruskal(edges, n);
+}
+
+
+// Label of the connected component of each of the n vertices of the graph
+// with the edges in the columns of E, numbered in order of appearance. The
+// edges are merged concurrently in a disjoint set whose roots are the smallest
+// vertices of the components, so the components appear in the order of their
+// roots and the labels follow from a prefix sum over the roots
+inline Eigen::VectorXi connected_components(const Eigen::MatrixXi& E, int n,
+                                            int n_threads = 1)
+{
+    // Initialize a disjoint set
+    ConcurrentDisjointSet djs(n);
+
+    // Fill the disjoint set
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (Eigen::Index i = 0; i < E.cols(); i++) {
+        djs.merge(E(0, i), E(1, i));
+    }
+
+    // Root of each vertex
+    Eigen::VectorXi id(n);
+
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (int i = 0; i < n; i++) {
+        id(i) = djs.root(i);
+    }
+
+    // Number of roots in each block of vertices, and the number of roots
+    // before each block
+    const int block_size = 4096;
+    int n_blocks = (n + block_size - 1) / block_size;
+    std::vector<int> offsets(n_blocks + 1, 0);
+
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (int b = 0; b < n_blocks; b++) {
+        int stop = std::min(n, (b + 1) * block_size);
+
+        for (int i = b * block_size; i < stop; i++) {
+            offsets[b + 1] += id(i) == i;
+        }
+    }
+
+    for (int b = 0; b < n_blocks; b++) offsets[b + 1] += offsets[b];
+
+    // Label the roots, a root precedes the other vertices of its component
+    // so their labels are only read after a barrier
+    #pragma omp parallel num_threads(n_threads)
+    {
+        #pragma omp for schedule(static)
+        for (int b = 0; b < n_blocks; b++) {
+            int stop = std::min(n, (b + 1) * block_size);
+            int c = offsets[b];
+
+            for (int i = b * block_size; i < stop; i++) {
+                if (id(i) == i) id(i) = -1 - c++;
+            }
+        }
+
+        #pragma omp for schedule(static)
+        for (int i = 0; i < n; i++) {
+            if (id(i) >= 0) id(i) = id(id(i));
+        }
+
+        #pragma omp for schedule(static)
+        for (int i = 0; i < n; i++) {
+            if (id(i) < 0) id(i) = -1 - id(i);
+        }
+    }
+
+    return id;
+}
+
+// Edges that connect the connected components of the graph with the edges in
+// the columns of E, found with Boruvka's algorithm on the objects in the
+// columns of X: in each round, every component is connected to the nearest
+// object outside of it, which is found with a single k-d tree. The number of
+// components at least halves in each round. The result is a minimum spanning
+// tree of the components, where the distance between two components is the
+// smallest distance between their objects. Ties are broken by the indices of
+// the objects
+inline void connect_components(const Eigen::MatrixXd& X,
+                               const Eigen::MatrixXi& E,
+                               Eigen::MatrixXi& edges,
+                               Eigen::VectorXd& distances,
+                               int n_threads = 1)
+{
+    int n = int(X.cols());
+
+    // Component of each object
+    Eigen::VectorXi id = connected_components(E, n, n_threads);
+    int c = n > 0 ? id.maxCoeff() + 1 : 0;
+
+    edges.resize(2, std::max(c - 1, 0));
+    distances.resize(std::max(c - 1, 0));
+
+    if (c <= 1) return;
+
+    KDTree tree(X, 16, n_threads);
+    DisjointSet components(c);
+    std::vector<int> labels(n);
+    int n_edges = 0;
+
+    while (n_edges < c - 1) {
+        // Label each object by the root of its merged component
+        for (int i = 0; i < n; i++) labels[i] = components.root(id(i));
+
+        std::vector<int> node_labels = tree.node_labels(labels);
+
+        // Nearest object in another component for each object
+        std::vector<std::pair<double, int>> nearest(n);
+
+        #pragma omp parallel num_threads(n_threads)
+        {
+            Eigen::VectorXd q(X.rows());
+
+            #pragma omp for schedule(dynamic, 256)
+            for (int i = 0; i < n; i++) {
+                q = X.col(i);
+                nearest[i] = {std::numeric_limits<double>::infinity(), -1};
+                tree.search_other(q, labels[i], labels, node_labels,
+                                  nearest[i], 0, 0, n, 0);
+            }
+        }
+
+        // Shortest edge leaving each component, ordered by the distance and
+        // then by the smaller and larger object index
+        std::vector<std::tuple<double, int, int>> shortest(
+            c, {std::numeric_limits<double>::infinity(), n, n}
+        );
+
+        for (int i = 0; i < n; i++) {
+            int j = nearest[i].second;
+            std::tuple<double, int, int> edge(
+                nearest[i].first, std::min(i, j), std::max(i, j)
+            );
+
+            if (edge < shortest[labels[i]]) shortest[labels[i]] = edge;
+        }
+
+        // Add the shortest edges in order, an edge may be the shortest for
+        // both of its components
+        std::sort(shortest.begin(), shortest.end());
+
+        for (const auto& [d, a, b] : shortest) {
+            if (b == n) break;
+            if (components.connected(id(a), id(b))) continue;
+
+            components.merge(id(a), id(b));
+            edges(0, n_edges) = a;
+            edges(1, n_edges) = b;
+            distances(n_edges) = std::sqrt(d);
+            n_edges++;
+        }
+    }
+}
+
+#endif // CCMMR_GRAPHS_H
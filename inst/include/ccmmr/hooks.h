@@ -0,0 +1,26 @@
+#ifndef CCMMR_HOOKS_H
+#define CCMMR_HOOKS_H
+
+#include <functional>
+#include <string>
+
+
+// Callbacks through which the solver interacts with its host. The interrupt
+// hook is called once per iteration on the main thread and may throw to abort
+// the minimization, the log hook receives progress messages. Both are optional
+struct CCMMHooks {
+    std::function<void()> interrupt;
+    std::function<void(const std::string&)> log;
+
+    void check_interrupt() const
+    {
+        if (interrupt) interrupt();
+    }
+
+    void print(const std::string& message) const
+    {
+        if (log) log(message);
+    }
+};
+
+#endif // CCMMR_HOOKS_H
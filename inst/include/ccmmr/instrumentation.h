@@ -0,0 +1,138 @@
+#ifndef CCMMR_INSTRUMENTATION_H
+#define CCMMR_INSTRUMENTATION_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// Phases of the solver for which the wall time and the number of calls are
+// recorded. The update and fuse phases include the time spent computing the
+// distances between the clusters
+enum CCMMPhase {
+    CCMM_PHASE_MINIMIZE = 0,
+    CCMM_PHASE_UPDATE = 1,
+    CCMM_PHASE_DISTANCES = 2,
+    CCMM_PHASE_FUSE = 3,
+    CCMM_PHASE_LOSS = 4,
+    CCMM_PHASE_COPY = 5,
+    CCMM_N_PHASES = 6
+};
+
+
+inline const char* phase_name(int phase)
+{
+    static const char* names[CCMM_N_PHASES] = {
+        "minimize", "update", "update_distances", "fuse", "loss_fusions",
+        "warm_start_copies"
+    };
+
+    return names[phase];
+}
+
+
+// Opt-in record of where the solver spends its time. Each thread that runs
+// the solver, such as the concurrent probes in phase 2 of ccmm_clustering,
+// writes to its own slot, the slots are summed when reading the totals
+struct CCMMInstrumentation {
+    struct Slot {
+        std::array<double, CCMM_N_PHASES> seconds{};
+        std::array<long, CCMM_N_PHASES> calls{};
+        int peak_edges = 0;
+        int peak_clusters = 0;
+    };
+
+    std::vector<Slot> slots;
+
+    explicit CCMMInstrumentation(int n_threads = 1) :
+        slots(std::max(n_threads, 1))
+    {
+
+    }
+
+    Slot& slot()
+    {
+#ifdef _OPENMP
+        int thread = omp_get_thread_num();
+#else
+        int thread = 0;
+#endif
+
+        return slots[std::min(thread, int(slots.size()) - 1)];
+    }
+
+    void record_size(int n_edges, int n_clusters)
+    {
+        Slot& s = slot();
+        s.peak_edges = std::max(s.peak_edges, n_edges);
+        s.peak_clusters = std::max(s.peak_clusters, n_clusters);
+    }
+
+    double seconds(int phase) const
+    {
+        double result = 0;
+        for (const Slot& s : slots) result += s.seconds[phase];
+
+        return result;
+    }
+
+    long calls(int phase) const
+    {
+        long result = 0;
+        for (const Slot& s : slots) result += s.calls[phase];
+
+        return result;
+    }
+
+    int peak_edges() const
+    {
+        int result = 0;
+        for (const Slot& s : slots) result = std::max(result, s.peak_edges);
+
+        return result;
+    }
+
+    int peak_clusters() const
+    {
+        int result = 0;
+        for (const Slot& s : slots) result = std::max(result, s.peak_clusters);
+
+        return result;
+    }
+};
+
+
+// Adds the wall time of its scope to a phase, does nothing if instrumentation
+// is a null pointer
+struct CCMMTimer {
+    CCMMInstrumentation* instrumentation;
+    int phase;
+    std::chrono::steady_clock::time_point start;
+
+    CCMMTimer(CCMMInstrumentation* instrumentation, int phase) :
+        instrumentation(instrumentation), phase(phase)
+    {
+        if (instrumentation != nullptr) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~CCMMTimer()
+    {
+        if (instrumentation != nullptr) {
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+            CCMMInstrumentation::Slot& s = instrumentation->slot();
+            s.seconds[phase] += elapsed.count();
+            s.calls[phase]++;
+        }
+    }
+};
+
+#endif // CCMMR_INSTRUMENTATION_H
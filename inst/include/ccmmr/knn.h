@@ -0,0 +1,242 @@
+#ifndef CCMMR_KNN_H
+#define CCMMR_KNN_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+
+// Balanced k-d tree over the columns of X. Each node splits its objects at the
+// median of the variable with the largest range, so the tree is stored
+// implicitly: node i has children 2i + 1 and 2i + 2, and the objects of a node
+// at depth d are a contiguous range of order that follows from halving the
+// range of its parent. The two halves of a node are built in parallel
+struct KDTree {
+    const Eigen::MatrixXd& X;
+    std::vector<int> order;
+    std::vector<int> split_dim;
+    std::vector<double> split_value;
+    int depth = 0;
+
+    KDTree(const Eigen::MatrixXd& X, int leaf_size = 16, int n_threads = 1) :
+        X(X)
+    {
+        int n = int(X.cols());
+
+        order.resize(n);
+        for (int i = 0; i < n; i++) order[i] = i;
+
+        // Number of levels such that each leaf holds at most leaf_size
+        // objects
+        while ((n >> depth) > leaf_size) depth++;
+
+        split_dim.resize((std::size_t(1) << depth) - 1);
+        split_value.resize(split_dim.size());
+
+        #pragma omp parallel num_threads(n_threads)
+        #pragma omp single
+        build(0, 0, n, 0);
+    }
+
+    void build(int node, int start, int stop, int level)
+    {
+        if (level == depth) return;
+
+        // Variable with the largest range among the objects of the node
+        Eigen::VectorXd lower = X.col(order[start]);
+        Eigen::VectorXd upper = lower;
+
+        for (int i = start + 1; i < stop; i++) {
+            lower = lower.cwiseMin(X.col(order[i]));
+            upper = upper.cwiseMax(X.col(order[i]));
+        }
+
+        int dim;
+        static_cast<void>((upper - lower).maxCoeff(&dim));
+
+        // Split at the median, the objects before mid do not exceed the split
+        // value and the objects after it are not smaller
+        int mid = start + (stop - start) / 2;
+        std::nth_element(
+            order.begin() + start, order.begin() + mid, order.begin() + stop,
+            [&](int a, int b) { return X(dim, a) < X(dim, b); }
+        );
+
+        split_dim[node] = dim;
+        split_value[node] = X(dim, order[mid]);
+
+        // Only spawn tasks for large nodes
+        #pragma omp task if (stop - start > 8192)
+        build(2 * node + 1, start, mid, level + 1);
+
+        build(2 * node + 2, mid, stop, level + 1);
+
+        #pragma omp taskwait
+    }
+
+    // Keep the k objects closest to q in a max-heap of (squared distance,
+    // index) pairs, ties are broken by the index
+    void search(const Eigen::VectorXd& q, int k,
+                std::vector<std::pair<double, int>>& heap, int node, int start,
+                int stop, int level) const
+    {
+        if (level == depth) {
+            for (int i = start; i < stop; i++) {
+                std::pair<double, int> candidate(
+                    (X.col(order[i]) - q).squaredNorm(), order[i]
+                );
+
+                if (int(heap.size()) < k) {
+                    heap.push_back(candidate);
+                    std::push_heap(heap.begin(), heap.end());
+                } else if (candidate < heap.front()) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = candidate;
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+
+            return;
+        }
+
+        int mid = start + (stop - start) / 2;
+        double diff = q(split_dim[node]) - split_value[node];
+
+        // Visit the half that contains q first, the other half only if it
+        // can contain objects closer than the current k-th neighbor
+        if (diff < 0) {
+            search(q, k, heap, 2 * node + 1, start, mid, level + 1);
+
+            if (int(heap.size()) < k || diff * diff <= heap.front().first) {
+                search(q, k, heap, 2 * node + 2, mid, stop, level + 1);
+            }
+        } else {
+            search(q, k, heap, 2 * node + 2, mid, stop, level + 1);
+
+            if (int(heap.size()) < k || diff * diff <= heap.front().first) {
+                search(q, k, heap, 2 * node + 1, start, mid, level + 1);
+            }
+        }
+    }
+
+    // Label shared by all objects of each node, or -1 if the objects of the
+    // node have different labels. The nodes include the leaves, which follow
+    // the internal nodes in the same layout
+    std::vector<int> node_labels(const std::vector<int>& labels) const
+    {
+        std::vector<int> result((std::size_t(2) << depth) - 1);
+        fill_node_labels(labels, result, 0, 0, int(order.size()), 0);
+
+        return result;
+    }
+
+    int fill_node_labels(const std::vector<int>& labels,
+                         std::vector<int>& result, int node, int start,
+                         int stop, int level) const
+    {
+        if (level == depth) {
+            int label = start < stop ? labels[order[start]] : -1;
+
+            for (int i = start + 1; i < stop && label >= 0; i++) {
+                if (labels[order[i]] != label) label = -1;
+            }
+
+            result[node] = label;
+            return label;
+        }
+
+        int mid = start + (stop - start) / 2;
+        int left = fill_node_labels(labels, result, 2 * node + 1, start, mid,
+                                    level + 1);
+        int right = fill_node_labels(labels, result, 2 * node + 2, mid, stop,
+                                     level + 1);
+
+        result[node] = left == right ? left : -1;
+        return result[node];
+    }
+
+    // Nearest object to q among the objects whose label differs from label,
+    // as a (squared distance, index) pair. Nodes in which all objects have
+    // the label are skipped
+    void search_other(const Eigen::VectorXd& q, int label,
+                      const std::vector<int>& labels,
+                      const std::vector<int>& node_labels,
+                      std::pair<double, int>& best, int node, int start,
+                      int stop, int level) const
+    {
+        if (node_labels[node] == label) return;
+
+        if (level == depth) {
+            for (int i = start; i < stop; i++) {
+                if (labels[order[i]] == label) continue;
+
+                std::pair<double, int> candidate(
+                    (X.col(order[i]) - q).squaredNorm(), order[i]
+                );
+
+                if (candidate < best) best = candidate;
+            }
+
+            return;
+        }
+
+        int mid = start + (stop - start) / 2;
+        double diff = q(split_dim[node]) - split_value[node];
+
+        if (diff < 0) {
+            search_other(q, label, labels, node_labels, best, 2 * node + 1,
+                         start, mid, level + 1);
+
+            if (diff * diff <= best.first) {
+                search_other(q, label, labels, node_labels, best,
+                             2 * node + 2, mid, stop, level + 1);
+            }
+        } else {
+            search_other(q, label, labels, node_labels, best, 2 * node + 2,
+                         mid, stop, level + 1);
+
+            if (diff * diff <= best.first) {
+                search_other(q, label, labels, node_labels, best,
+                             2 * node + 1, start, mid, level + 1);
+            }
+        }
+    }
+
+    // Indices and distances of the k nearest objects of each object
+    // (including the object itself) in the columns, in ascending order of the
+    // distance
+    void query(int k, Eigen::MatrixXi& indices, Eigen::MatrixXd& distances,
+               int n_threads = 1) const
+    {
+        int n = int(X.cols());
+        k = std::min(k, n);
+
+        indices.resize(k, n);
+        distances.resize(k, n);
+
+        #pragma omp parallel num_threads(n_threads)
+        {
+            std::vector<std::pair<double, int>> heap;
+            heap.reserve(k);
+            Eigen::VectorXd q(X.rows());
+
+            #pragma omp for schedule(dynamic, 256)
+            for (int j = 0; j < n; j++) {
+                q = X.col(j);
+                heap.clear();
+                search(q, k, heap, 0, 0, n, 0);
+                std::sort_heap(heap.begin(), heap.end());
+
+                for (int i = 0; i < k; i++) {
+                    indices(i, j) = heap[i].second;
+                    distances(i, j) = std::sqrt(heap[i].first);
+                }
+            }
+        }
+    }
+};
+
+#endif // CCMMR_KNN_H
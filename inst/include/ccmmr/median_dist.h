@@ -0,0 +1,142 @@
+#ifndef CCMMR_MEDIAN_DIST_H
+#define CCMMR_MEDIAN_DIST_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+inline double median(std::vector<double>& vec)
+{
+    // Preliminaries
+    double result;
+    std::ptrdiff_t nth = std::ptrdiff_t(vec.size() / 2);
+
+    // Partial sort vector
+    std::nth_element(vec.begin(), vec.begin() + nth, vec.end());
+
+    // Compute median
+    if (vec.size() % 2 == 1) {
+        result = vec[nth];
+    } else {
+        double max = *std::max_element(vec.begin(), vec.begin() + nth - 1);
+        result = 0.5 * (max + vec[nth]);
+    }
+
+    return result;
+}
+
+
+inline double partial_median_dist(const Eigen::MatrixXd& X, int start, int stop)
+{
+    // The number of distances overflows int for more than 65536 objects
+    std::size_t n = std::size_t(stop - start);
+    std::size_t n_dists = (n * (n - 1)) >> 1;
+    std::vector<double> dists(n_dists);
+
+    std::size_t idx = 0;
+
+    for (int i = start; i < stop; i++) {
+        for (int j = start; j < i; j++) {
+            dists[idx] = (X.col(i) - X.col(j)).norm();
+            idx++;
+        }
+    }
+
+    // Compute median
+    double result = median(dists);
+
+    return result;
+}
+
+
+inline double median_dist(const Eigen::MatrixXd& X)
+{
+    // Preliminaries
+    int n_parts = 1;
+    int n = int(X.cols());
+    double result;
+
+    if (n > 2000) {
+        n_parts = (n + 2000) / 2000;
+    }
+
+    if (n_parts == 1) {
+        result = partial_median_dist(X, 0, n);
+    } else {
+        // Medians of the parts
+        std::vector<double> medians(n_parts);
+
+        // Size of the parts
+        int n_i = n / n_parts + 1;
+
+        // Compute medians
+        for (int i = 0; i < n_parts; i++) {
+            int start = i * n_i;
+            int stop = std::min((i + 1) * n_i, n);
+            medians[i] = partial_median_dist(X, start, stop);
+        }
+
+        result = median(medians);
+    }
+
+    return result;
+}
+
+
+// Number of random pairs such that the median of their distances lies between
+// the 0.5 - error and 0.5 + error quantiles of all pairwise distances with
+// probability at least 0.999, by the Dvoretzky-Kiefer-Wolfowitz inequality
+inline std::size_t median_sample_size(double error)
+{
+    return std::size_t(std::ceil(std::log(2 / 0.001) / (2 * error * error)));
+}
+
+
+// Mixing function of the splitmix64 generator, maps a counter to a
+// pseudorandom 64-bit value
+inline std::uint64_t splitmix64(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
+
+
+// Estimate of the median of the pairwise distances from a sample of random
+// pairs of objects, drawn with replacement. Pair k only depends on the seed
+// and k, so the estimate does not depend on the number of threads. If the
+// sample would not be smaller than the number of pairs, all pairs are used
+inline double sampled_median_dist(const Eigen::MatrixXd& X, double error,
+                                  std::uint64_t seed, int n_threads = 1)
+{
+    std::uint64_t n = std::uint64_t(X.cols());
+    std::size_t n_samples = median_sample_size(error);
+
+    if (n * (n - 1) / 2 <= n_samples) {
+        return partial_median_dist(X, 0, int(n));
+    }
+
+    std::vector<double> dists(n_samples);
+    std::uint64_t stream = splitmix64(seed);
+
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (std::ptrdiff_t k = 0; k < std::ptrdiff_t(n_samples); k++) {
+        std::uint64_t i = splitmix64(stream + 2 * std::uint64_t(k)) % n;
+        std::uint64_t j = splitmix64(stream + 2 * std::uint64_t(k) + 1) % (n - 1);
+
+        // Skip i, so that j is uniform over the other objects
+        if (j >= i) j++;
+
+        dists[k] = (X.col(Eigen::Index(i)) - X.col(Eigen::Index(j))).norm();
+    }
+
+    return median(dists);
+}
+
+#endif // CCMMR_MEDIAN_DIST_H
@@ -0,0 +1,430 @@
+#ifndef CCMMR_PATH_H
+#define CCMMR_PATH_H
+
+#include <Eigen/Eigen>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "hooks.h"
+#include "instrumentation.h"
+#include "sink.h"
+#include "solver.h"
+#include "storage.h"
+
+
+// Minimize the convex clustering loss function for each value in lambdas,
+// warm starting each minimization from the previous solution. If sink is not
+// a null pointer, the clusterpath, losses, and convergence norms are passed to
+// the sink instead of being stored in the results. If instrumentation is not a
+// null pointer, the time spent in each phase is recorded in it. The arrays of
+// the results are allocated by storage if it is not a null pointer. Scalar is
+// the precision of the centroids, double or float
+template <typename Scalar = double>
+CCMMResults
+ccmm_clusterpath(const Eigen::Ref<const Eigen::MatrixXd>& X,
+                 const Eigen::SparseMatrix<double>& W,
+                 const Eigen::VectorXd& lambdas,
+                 const Eigen::VectorXd& target_losses,
+                 double eps_conv,
+                 double eps_fusions,
+                 bool scale,
+                 bool save_clusterpath,
+                 bool use_target,
+                 bool save_losses,
+                 bool save_convergence_norms,
+                 int burnin_iter,
+                 int max_iter_conv,
+                 int n_threads,
+                 int acceleration,
+                 int history,
+                 CCMMSink* sink,
+                 const CCMMHooks& hooks,
+                 CCMMInstrumentation* instrumentation = nullptr,
+                 std::shared_ptr<CCMMStorage> storage = nullptr)
+{
+    // Number of observations to clusters
+    int n_obs = int(X.cols());
+    int n_vars = int(X.rows());
+    int n_lambdas = int(lambdas.size());
+
+    // Initialize CCMM structs
+    CCMMVariables<Scalar> variables(X, W);
+    CCMMConstants constants(X, W, eps_conv, eps_fusions, burnin_iter,
+                            max_iter_conv, scale, use_target, n_threads,
+                            acceleration, history);
+    constants.hooks = hooks;
+    constants.instrumentation = instrumentation;
+
+    // If a sink is provided, the results for each lambda are written to it
+    // instead of being kept in memory
+    CCMMResults results(n_obs, n_vars, n_lambdas,
+                        save_clusterpath && sink == nullptr, storage);
+
+    // Minimize the convex clustering loss function for each lambda
+    for (int i = 0; i < n_lambdas; i++) {
+        auto [losses_i, convergence_norms_i] = variables.minimize(
+            constants, lambdas(i), target_losses(i), save_convergence_norms
+        );
+        results.add_results(variables, lambdas(i));
+
+        if (sink != nullptr) {
+            sink->add_results(variables, lambdas(i),
+                              save_losses ? losses_i : Eigen::VectorXd(),
+                              convergence_norms_i);
+            continue;
+        }
+
+        // Add losses for this minimization to the list
+        if (save_losses) {
+            results.losses.push_back(losses_i);
+        }
+
+        // Add the differences between the iterates to the list
+        if (save_convergence_norms) {
+            results.convergence_norms.push_back(convergence_norms_i);
+        }
+    }
+
+    // Do some cleaning up on the variables
+    results.finalize();
+
+    return results;
+}
+
+
+// Progress message for a single minimization in the search for a number of
+// clusters
+inline std::string format_search_step(double lambda, int n_clusters)
+{
+    std::ostringstream message;
+    message << std::fixed << std::setprecision(5);
+    message << "    lambda = " << lambda;
+    message << " | number of clusters: " << n_clusters << '\n';
+
+    return message.str();
+}
+
+
+// Search for values for lambda that result in each number of clusters in
+// [target_low, target_high]. Phase 1 increases lambda until the target is
+// attained or passed, phase 2 refines lambda by bisection, or by evaluating
+// n_probes values concurrently if n_probes > 1. If instrumentation is not a
+// null pointer, the time spent in each phase is recorded in it, it should have
+// a slot for each of the n_probes threads. The arrays of the results are
+// allocated by storage if it is not a null pointer. Scalar is the precision of
+// the centroids, double or float
+template <typename Scalar = double>
+CCMMResults
+ccmm_clustering(const Eigen::Ref<const Eigen::MatrixXd>& X,
+                const Eigen::SparseMatrix<double>& W,
+                double eps_conv,
+                double eps_fusions,
+                bool scale,
+                bool save_clusterpath,
+                int burnin_iter,
+                int max_iter_conv,
+                int target_low,
+                int target_high,
+                int max_iter_phase_1,
+                int max_iter_phase_2,
+                int verbose,
+                double lambda_init,
+                double factor,
+                int n_threads,
+                int acceleration,
+                int history,
+                int n_probes,
+                const CCMMHooks& hooks,
+                CCMMInstrumentation* instrumentation = nullptr,
+                std::shared_ptr<CCMMStorage> storage = nullptr)
+{
+    // Number of observations to clusters
+    int n_obs = int(X.cols());
+    int n_vars = int(X.rows());
+
+    // Initialize CCMM structs
+    CCMMVariables<Scalar> variables(X, W);
+    CCMMConstants constants(X, W, eps_conv, eps_fusions, burnin_iter,
+                            max_iter_conv, scale, false, n_threads,
+                            acceleration, history);
+    constants.hooks = hooks;
+    constants.instrumentation = instrumentation;
+    CCMMResults results(n_obs, n_vars, target_high - target_low + 1,
+                        save_clusterpath, storage);
+
+    // Variables for lambda
+    double lambda = lambda_init / (1 + factor) - 1e-8;
+    double lambda_lb = lambda;
+    double lambda_ub = lambda;
+    double lambda_target = lambda;
+
+    // Set current target for number of clusters
+    int current_target = std::min(n_obs - 1, target_high);
+
+    // Minimize loss for lambda = 0
+    static_cast<void>(variables.minimize(constants, 0, -1.0, false));
+
+    // Copy the variables as a warm start, recording the time spent
+    auto copy = [instrumentation](CCMMVariables<Scalar>& to,
+                                  const CCMMVariables<Scalar>& from) {
+        CCMMTimer timer(instrumentation, CCMM_PHASE_COPY);
+        to = from;
+    };
+
+    // Create variables struct to store the result if the target has been
+    // found
+    CCMMVariables<Scalar> variables_target = variables;
+
+    // Create variables struct to have a warm start to return to while
+    // continuously increasing lambda when looking for the current target
+    CCMMVariables<Scalar> variables_lb = variables;
+
+    // If the number of observations is part of the target interval, add the
+    // solution for lambda = 0
+    if (target_high == n_obs) {
+        if (verbose > 0) {
+            hooks.print("Searching for " + std::to_string(n_obs) + " clusters\n");
+            hooks.print("    lambda = 0 | number of clusters: " +
+                        std::to_string(n_obs) + "\n");
+        }
+
+        results.add_results(variables_target, 0);
+
+        // Increment the counter for the number of targets found
+        results.targets_found++;
+    }
+
+    while (current_target >= target_low) {
+        if (verbose > 0) {
+            hooks.print("Searching for " + std::to_string(current_target) +
+                        " clusters\n");
+            hooks.print("Phase 1: acquiring lower bound for lambda\n");
+        }
+
+        // Set warm start
+        copy(variables, variables_target);
+        lambda = (lambda_target + 1e-8) * (1 + factor);
+        lambda_lb = lambda_target + 1e-8;
+
+        // Booleans to store how phase 1 ends
+        bool target_found = false;      // Target was found
+        bool target_sandwiched = false; // Values above and below target found
+
+        // Counter for the number of iterations
+        int iter = 0;
+
+        while (iter < max_iter_phase_1 && lambda < 1e30) {
+            // Minimize the loss
+            static_cast<void>(variables.minimize(constants, lambda, -1.0, false));
+            results.phase_1_instances++;
+
+            if (verbose > 0) {
+                hooks.print(format_search_step(lambda, variables.num_clusters()));
+            }
+
+            // Check each case
+            if (variables.num_clusters() > current_target) {
+                // Store result as a warm start for the next minimization
+                copy(variables_lb, variables);
+                lambda_lb = lambda;
+
+                // Increase lambda
+                lambda *= 1 + factor;
+            } else if (variables.num_clusters() == current_target) {
+                // Store solution for which target was attained and keep the
+                // corresponding lambda as the upper bound for this number of
+                // clusters
+                copy(variables_target, variables);
+                lambda_target = lambda;
+                lambda_ub = lambda;
+
+                // Store that the target was found and break the while loop
+                target_found = true;
+                break;
+            } else {
+                // Store upper bound for lambda
+                lambda_ub = lambda;
+
+                // Store that the target was sandwiched and break the loop
+                target_sandwiched = true;
+                break;
+            }
+
+            // Increment the counter for the number of phase 1 iterations
+            iter++;
+        }
+
+        // If the target was found or sandwiched, refine lambda. In case the
+        // target was found, perform fewer refinement iterations
+        if (target_found || target_sandwiched) {
+            if (verbose > 0) {
+                hooks.print("Phase 2: refining lambda\n");
+            }
+
+            iter = target_found * max_iter_phase_2 / 2;
+
+            // Speculative bisection: evaluate several values for lambda in
+            // the bracket concurrently, each warm started from variables_lb
+            // and running single threaded. Each round narrows the bracket by
+            // a factor n_probes + 1, so the number of rounds is chosen such
+            // that the bracket becomes as narrow as after the remaining
+            // bisection steps
+            if (n_probes > 1) {
+                CCMMConstants constants_probe = constants;
+                constants_probe.n_threads = 1;
+
+                int max_rounds = int(std::ceil(
+                    (max_iter_phase_2 - iter) * std::log(2.0) /
+                    std::log(n_probes + 1.0)
+                ));
+
+                // Variables for each guess, which are overwritten by the warm
+                // start in each round
+                std::vector<CCMMVariables<Scalar>> probes;
+                {
+                    CCMMTimer timer(instrumentation, CCMM_PHASE_COPY);
+                    probes.assign(n_probes, variables_lb);
+                }
+
+                int round = 0;
+
+                while (round < max_rounds && lambda_ub - lambda_lb > 1e-6) {
+                    // Equally spaced guesses for lambda
+                    Eigen::VectorXd lambdas_probe(n_probes);
+                    for (int k = 0; k < n_probes; k++) {
+                        lambdas_probe(k) = lambda_lb +
+                            (k + 1) * (lambda_ub - lambda_lb) / (n_probes + 1);
+                    }
+
+                    // Minimize the loss for each guess
+                    #pragma omp parallel for num_threads(n_probes) schedule(static, 1)
+                    for (int k = 0; k < n_probes; k++) {
+                        if (round > 0) copy(probes[k], variables_lb);
+
+                        static_cast<void>(probes[k].minimize(
+                            constants_probe, lambdas_probe(k), -1.0, false, false
+                        ));
+                    }
+                    results.phase_2_instances += n_probes;
+
+                    // Check for user interrupt
+                    hooks.check_interrupt();
+
+                    if (verbose > 0) {
+                        for (int k = 0; k < n_probes; k++) {
+                            hooks.print(format_search_step(
+                                lambdas_probe(k), probes[k].num_clusters()
+                            ));
+                        }
+                    }
+
+                    // Find the first guess that did not exceed the target
+                    int k_ub = 0;
+                    while (k_ub < n_probes &&
+                           probes[k_ub].num_clusters() > current_target) {
+                        k_ub++;
+                    }
+
+                    // The guess before it is the new lower bound and the
+                    // warm start for the next round
+                    if (k_ub > 0) {
+                        copy(variables_lb, probes[k_ub - 1]);
+                        lambda_lb = lambdas_probe(k_ub - 1);
+                    }
+
+                    // The guess itself is the new upper bound, store it if
+                    // the target was attained
+                    if (k_ub < n_probes) {
+                        lambda_ub = lambdas_probe(k_ub);
+
+                        if (probes[k_ub].num_clusters() == current_target) {
+                            copy(variables_target, probes[k_ub]);
+                            lambda_target = lambda_ub;
+                            target_found = true;
+                        }
+                    }
+
+                    // Increment the counter for the number of rounds
+                    round++;
+                }
+            } else {
+                while (iter < max_iter_phase_2 && lambda_ub - lambda_lb > 1e-6) {
+                    // New guess for lambda
+                    lambda = 0.5 * (lambda_lb + lambda_ub);
+
+                    // Minimize the loss
+                    static_cast<void>(variables.minimize(constants, lambda, -1.0, false));
+                    results.phase_2_instances++;
+
+                    if (verbose > 0) {
+                        hooks.print(format_search_step(
+                            lambda, variables.num_clusters()
+                        ));
+                    }
+
+                    if (variables.num_clusters() > current_target) {
+                        // Store result as a warm start for the next minimization
+                        // and set new lower bound for lambda
+                        copy(variables_lb, variables);
+                        lambda_lb = lambda;
+                    } else if (variables.num_clusters() == current_target) {
+                        // Store solution for which target was attained and keep
+                        // the corresponding lambda as the upper bound for this
+                        // number of clusters
+                        copy(variables_target, variables);
+                        lambda_target = lambda;
+                        lambda_ub = lambda;
+
+                        // Store that the target was found
+                        target_found = true;
+
+                        // Reset variables to warm start
+                        copy(variables, variables_lb);
+                    } else {
+                        // Set new upper bound for lambda
+                        lambda_ub = lambda;
+
+                        // Reset variables to warm start
+                        copy(variables, variables_lb);
+                    }
+
+                    // Increment the counter for the number of phase 2 iterations
+                    iter++;
+                }
+            }
+
+            if (target_found) {
+                // Add the result
+                results.add_results(variables_target, lambda_target);
+
+                // Increment the counter for the number of targets found
+                results.targets_found++;
+            } else {
+                // Start the next search from the lower bound of this search
+                copy(variables_target, variables_lb);
+                lambda_target = lambda_lb;
+            }
+        } else {
+            break;
+        }
+
+        // Drop the merge table entries of the minimizations that were
+        // discarded during this search, so that the arena does not grow with
+        // the number of minimizations
+        variables.merges->compact({&variables.merge_head,
+                                   &variables_target.merge_head,
+                                   &variables_lb.merge_head});
+
+        current_target--;
+    }
+
+    // Do some cleaning up on the variables
+    results.finalize();
+
+    return results;
+}
+
+#endif // CCMMR_PATH_H
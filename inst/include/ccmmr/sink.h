@@ -0,0 +1,112 @@
+#ifndef CCMMR_SINK_H
+#define CCMMR_SINK_H
+
+#include <Eigen/Eigen>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include "solver.h"
+
+
+// Receives the result for each lambda as soon as it is available. The
+// cluster of each observation is passed as an index into the centroids,
+// which are passed in double precision, regardless of the precision of the
+// solver
+struct CCMMSink {
+    virtual ~CCMMSink() = default;
+
+    virtual void add_record(double lambda, double loss, int n_iterations,
+                            const Eigen::ArrayXi& membership,
+                            const Eigen::MatrixXd& M,
+                            const Eigen::VectorXd& losses,
+                            const Eigen::VectorXd& convergence_norms) = 0;
+
+    template <typename Scalar>
+    void add_results(const CCMMVariables<Scalar>& variables, double lambda,
+                     const Eigen::VectorXd& losses,
+                     const Eigen::VectorXd& convergence_norms)
+    {
+        add_record(lambda, variables.loss, variables.n_iterations,
+                   *variables.membership, variables.M.template cast<double>(),
+                   losses, convergence_norms);
+    }
+};
+
+
+// Append-only binary file that receives the result for each lambda as soon
+// as it is available. The file starts with the characters CCMMPATH followed
+// by the format version, the number of observations, and the number of
+// variables as 32-bit integers. Each lambda adds a record with lambda, the
+// loss, the number of iterations, the number of clusters c, the cluster label
+// of each observation, the c centroids, and the losses and convergence norms
+// preceded by their lengths
+struct CCMMFileSink : CCMMSink {
+    std::ofstream file;
+
+    CCMMFileSink(const std::string& path, int n_obs, int n_vars)
+    {
+        file.open(path, std::ios::binary | std::ios::trunc);
+
+        if (!file) {
+            throw std::runtime_error("Could not open " + path + " for writing");
+        }
+
+        file.write("CCMMPATH", 8);
+        write_int(1);
+        write_int(n_obs);
+        write_int(n_vars);
+    }
+
+    void write_int(int value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(int));
+    }
+
+    void write_double(double value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(double));
+    }
+
+    template <typename T>
+    void write_values(const T* values, Eigen::Index size)
+    {
+        file.write(reinterpret_cast<const char*>(values),
+                   std::streamsize(size * sizeof(T)));
+    }
+
+    void add_record(double lambda, double loss, int n_iterations,
+                    const Eigen::ArrayXi& membership,
+                    const Eigen::MatrixXd& M,
+                    const Eigen::VectorXd& losses,
+                    const Eigen::VectorXd& convergence_norms) override
+    {
+        // Info
+        write_double(lambda);
+        write_double(loss);
+        write_int(n_iterations);
+        write_int(int(M.cols()));
+
+        // Cluster labels, starting at one
+        Eigen::ArrayXi labels = membership + 1;
+
+        write_values(labels.data(), labels.size());
+
+        // Centroids
+        write_values(M.data(), M.size());
+
+        // Losses and convergence norms
+        write_int(int(losses.size()));
+        write_values(losses.data(), losses.size());
+        write_int(int(convergence_norms.size()));
+        write_values(convergence_norms.data(), convergence_norms.size());
+
+        // Make the record available to readers of the file
+        file.flush();
+
+        if (!file) {
+            throw std::runtime_error("Could not write to the result sink");
+        }
+    }
+};
+
+#endif // CCMMR_SINK_H
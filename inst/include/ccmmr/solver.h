@@ -0,0 +1,1400 @@
+#ifndef CCMMR_SOLVER_H
+#define CCMMR_SOLVER_H
+
+#include <Eigen/Eigen>
+#include <algorithm>
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "disjoint_set.h"
+#include "hooks.h"
+#include "instrumentation.h"
+#include "storage.h"
+
+
+// Convert a set of keys (row, col) and values into a sparse matrix, requires
+// the input to be already column major
+inline Eigen::SparseMatrix<double>
+sparse_from_dok(const Eigen::Matrix<int, 2, Eigen::Dynamic>& M_idx,
+                const Eigen::VectorXd& M_val, int n_rows, int n_cols)
+{
+    Eigen::SparseMatrix<double> result(n_rows, n_cols);
+
+    Eigen::Index nnz = M_val.size();
+    int count = 1;
+    int max_count = 1;
+
+    // Count maximum number of nonzero values per column
+    for (Eigen::Index i = 1; i < nnz; i++) {
+        if (M_idx(1, i) == M_idx(1, i - 1)) {
+            count++;
+        } else {
+            max_count = std::max(count, max_count);
+            count = 1;
+        }
+    }
+
+    // Reserve memory for the sparse matrix
+    result.reserve(Eigen::VectorXi::Constant(n_cols, max_count));
+
+    // Insert the elements
+    for (Eigen::Index i = 0; i < nnz; i++) {
+        if (M_idx(0, i) > M_idx(1, i)) {
+            result.insert(M_idx(0, i), M_idx(1, i)) = M_val(i);
+        }
+    }
+
+    // Compress
+    result.makeCompressed();
+
+    return result;
+}
+
+
+// Call f with the number of variables p as a compile-time constant if
+// p <= max_fixed_p, otherwise call f with Eigen::Dynamic. Fixed-size kernels
+// let Eigen unroll the operations on the columns of M, the dynamic kernels
+// rely on Eigen's packet vectorization. Both perform the same operations, only
+// the order of the summation in the norms may differ, so results agree up to
+// rounding errors
+constexpr int max_fixed_p = 16;
+
+template <int P = 1, typename F>
+void dispatch_p(int p, F&& f)
+{
+    if constexpr (P > max_fixed_p) {
+        f(std::integral_constant<int, Eigen::Dynamic>());
+    } else {
+        if (p == P) {
+            f(std::integral_constant<int, P>());
+        } else {
+            dispatch_p<P + 1>(p, std::forward<F>(f));
+        }
+    }
+}
+
+
+// Schemes to accelerate the MM updates after the burn-in iterations
+enum Acceleration {
+    ACCELERATION_NONE = 0,
+    ACCELERATION_DOUBLING = 1,
+    ACCELERATION_ANDERSON = 2,
+    ACCELERATION_NESTEROV = 3
+};
+
+
+struct CCMMConstants {
+    // View of the observations, which are not copied and have to outlive the
+    // constants
+    Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<>> X;
+    double eps_conv;
+    double eps_fusions;
+    double kappa_eps = 0.5;
+    double kappa_pen = 1.0;
+    int burn_in;
+    int max_iter;
+    int n_threads;
+    int acceleration;
+    int history;
+    bool use_target;
+    bool dense_loss = false;
+    CCMMHooks hooks;
+
+    // Optional record of the time spent in each phase, not owned
+    CCMMInstrumentation* instrumentation = nullptr;
+
+    CCMMConstants(const Eigen::Ref<const Eigen::MatrixXd>& X,
+                  const Eigen::SparseMatrix<double>& W,
+                  double eps_conv, double eps_fusions, int burn_in,
+                  int max_iter, bool scale, bool use_target, int n_threads,
+                  int acceleration, int history) :
+                  X(X.data(), X.rows(), X.cols(),
+                    Eigen::OuterStride<>(X.outerStride())),
+                  eps_conv(eps_conv), eps_fusions(eps_fusions),
+                  burn_in(burn_in), max_iter(max_iter), n_threads(n_threads),
+                  acceleration(acceleration), history(history),
+                  use_target(use_target)
+    {
+        // Scaling constants for the loss function
+        if (scale) {
+            double norm_X = X.norm();
+
+            kappa_eps = 1 / (2 * norm_X * norm_X);
+            kappa_pen = 1 / (norm_X * W.sum());
+        }
+    }
+};
+
+
+struct CCMMEdges {
+    // Edges (i, j) with i > j between c clusters, stored as contiguous arrays
+    // and sorted by j and then by i. The distances between the clusters are
+    // stored separately, as the edges only change when clusters are fused.
+    // The edges come from the nonzeros of a sparse matrix with int storage
+    // indices, so their number and the offsets below fit in int
+    int c = 0;
+    Eigen::ArrayXi i;
+    Eigen::ArrayXi j;
+    Eigen::ArrayXd w;
+
+    // The edges with j as their smaller endpoint are col_ptr[j], ...,
+    // col_ptr[j + 1] - 1. The edges with i as their larger endpoint are
+    // row_idx[row_ptr[i]], ..., row_idx[row_ptr[i + 1] - 1]
+    std::vector<int> col_ptr;
+    std::vector<int> row_ptr;
+    std::vector<int> row_idx;
+
+    CCMMEdges() {}
+
+    CCMMEdges(const Eigen::SparseMatrix<double>& W)
+    {
+        // Gather the nonzero elements below the diagonal of W
+        int n_edges = 0;
+
+        for (int jj = 0; jj < W.outerSize(); jj++) {
+            for (Eigen::SparseMatrix<double>::InnerIterator it(W, jj); it; ++it) {
+                if (it.row() > jj) n_edges++;
+            }
+        }
+
+        Eigen::ArrayXi a(n_edges);
+        Eigen::ArrayXi b(n_edges);
+        Eigen::ArrayXd v(n_edges);
+        int e = 0;
+
+        for (int jj = 0; jj < W.outerSize(); jj++) {
+            for (Eigen::SparseMatrix<double>::InnerIterator it(W, jj); it; ++it) {
+                if (it.row() > jj) {
+                    a(e) = int(it.row());
+                    b(e) = jj;
+                    v(e) = it.value();
+                    e++;
+                }
+            }
+        }
+
+        build(int(W.cols()), a, b, v);
+    }
+
+    CCMMEdges(int c, const Eigen::ArrayXi& a, const Eigen::ArrayXi& b,
+              const Eigen::ArrayXd& v)
+    {
+        build(c, a, b, v);
+    }
+
+    void build(int c_new, const Eigen::ArrayXi& a, const Eigen::ArrayXi& b,
+               const Eigen::ArrayXd& v)
+    {
+        // Construct the edge list from the edges (a, b) with a > b in
+        // arbitrary order, parallel edges are merged by summing their weights.
+        // The edges are sorted by two stable counting sorts, first by a and
+        // then by b, so that this takes O(c + number of edges) operations
+        c = c_new;
+        int n_in = int(v.size());
+
+        std::vector<int> count(c + 1, 0);
+        std::vector<int> order_a(n_in);
+        std::vector<int> order_ab(n_in);
+
+        // Sort by a
+        for (int e = 0; e < n_in; e++) count[a(e) + 1]++;
+        for (int k = 0; k < c; k++) count[k + 1] += count[k];
+        for (int e = 0; e < n_in; e++) order_a[count[a(e)]++] = e;
+
+        // Stable sort by b
+        std::fill(count.begin(), count.end(), 0);
+        for (int e = 0; e < n_in; e++) count[b(e) + 1]++;
+        for (int k = 0; k < c; k++) count[k + 1] += count[k];
+        for (int e = 0; e < n_in; e++) {
+            order_ab[count[b(order_a[e])]++] = order_a[e];
+        }
+
+        // Merge parallel edges, which are now adjacent
+        i.resize(n_in);
+        j.resize(n_in);
+        w.resize(n_in);
+
+        int n_edges = 0;
+
+        for (int e = 0; e < n_in; e++) {
+            int idx = order_ab[e];
+
+            if (n_edges > 0 && i(n_edges - 1) == a(idx) &&
+                    j(n_edges - 1) == b(idx)) {
+                w(n_edges - 1) += v(idx);
+            } else {
+                i(n_edges) = a(idx);
+                j(n_edges) = b(idx);
+                w(n_edges) = v(idx);
+                n_edges++;
+            }
+        }
+
+        i.conservativeResize(n_edges);
+        j.conservativeResize(n_edges);
+        w.conservativeResize(n_edges);
+
+        // Offsets of the columns and rows, within each row the edges are in
+        // ascending order of their column
+        col_ptr.assign(c + 1, 0);
+        row_ptr.assign(c + 1, 0);
+
+        for (int e = 0; e < n_edges; e++) {
+            col_ptr[j(e) + 1]++;
+            row_ptr[i(e) + 1]++;
+        }
+
+        for (int k = 0; k < c; k++) {
+            col_ptr[k + 1] += col_ptr[k];
+            row_ptr[k + 1] += row_ptr[k];
+        }
+
+        row_idx.resize(n_edges);
+        std::vector<int> fill(row_ptr.begin(), row_ptr.end() - 1);
+
+        for (int e = 0; e < n_edges; e++) {
+            row_idx[fill[i(e)]++] = e;
+        }
+    }
+
+    CCMMEdges contract(const Eigen::ArrayXi& membership, int c_new) const
+    {
+        // Relabel the endpoints of each edge by the clusters they are fused
+        // into. Edges within a cluster vanish and parallel edges between two
+        // clusters are merged into one edge with the sum of the weights
+        int n_edges = size();
+
+        Eigen::ArrayXi a(n_edges);
+        Eigen::ArrayXi b(n_edges);
+        Eigen::ArrayXd v(n_edges);
+        int n_new = 0;
+
+        for (int e = 0; e < n_edges; e++) {
+            int ii = membership(i(e));
+            int jj = membership(j(e));
+
+            if (ii == jj) continue;
+
+            a(n_new) = std::max(ii, jj);
+            b(n_new) = std::min(ii, jj);
+            v(n_new) = w(e);
+            n_new++;
+        }
+
+        return CCMMEdges(c_new, a.head(n_new), b.head(n_new), v.head(n_new));
+    }
+
+    int size() const
+    {
+        return int(w.size());
+    }
+};
+
+
+struct CCMMMergeArena {
+    // Merge table entries appended by a CCMMVariables struct and all its
+    // copies. Entries are never modified and each entry refers to the entry
+    // that was added before it by the same sequence of fusions, so a copy of
+    // the variables only stores the index of its last entry. Entries of
+    // copies that are discarded remain in the arena until it is compacted
+    std::vector<int> a;
+    std::vector<int> b;
+    std::vector<int> prev;
+    std::vector<double> height;
+    std::mutex mutex;
+
+    CCMMMergeArena(int n)
+    {
+        a.reserve(n);
+        b.reserve(n);
+        prev.reserve(n);
+        height.reserve(n);
+    }
+
+    int append(int label_a, int label_b, double lambda, int previous)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        a.push_back(label_a);
+        b.push_back(label_b);
+        height.push_back(lambda);
+        prev.push_back(previous);
+
+        return int(a.size()) - 1;
+    }
+
+    // Remove the entries that cannot be reached from the last entries of the
+    // variables that are still in use, given by heads, which are set to the
+    // new indices of those entries. The order of the entries is preserved
+    void compact(std::initializer_list<int*> heads)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Mark the entries that can be reached, each chain is only followed
+        // until it joins a chain that was marked before
+        int size = int(a.size());
+        std::vector<int> index(size, -1);
+
+        for (int* head : heads) {
+            for (int k = *head; k >= 0 && index[k] < 0; k = prev[k]) {
+                index[k] = 0;
+            }
+        }
+
+        // Move the marked entries to the front
+        int n_kept = 0;
+
+        for (int k = 0; k < size; k++) {
+            if (index[k] < 0) continue;
+
+            index[k] = n_kept;
+            a[n_kept] = a[k];
+            b[n_kept] = b[k];
+            height[n_kept] = height[k];
+            prev[n_kept] = prev[k] < 0 ? -1 : index[prev[k]];
+            n_kept++;
+        }
+
+        a.resize(n_kept);
+        b.resize(n_kept);
+        height.resize(n_kept);
+        prev.resize(n_kept);
+
+        for (int* head : heads) {
+            if (*head >= 0) *head = index[*head];
+        }
+    }
+};
+
+
+template <typename Scalar>
+struct CCMMAcceleration {
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> MatrixX;
+
+    // State of the Anderson and Nesterov acceleration schemes: the number of
+    // accelerated updates since the last restart, the previous (unaccelerated)
+    // update and residual, and the differences between the last few updates
+    // and residuals stored as columns in a circular buffer
+    int iter = 0;
+    int history_size = 0;
+    int history_index = 0;
+    MatrixX M_prev;
+    MatrixX R_prev;
+    MatrixX delta_M;
+    MatrixX delta_R;
+
+    CCMMAcceleration() {}
+
+    // The state is only used within a single minimization, which starts with
+    // a reset, so copies of the variables do not duplicate the buffers
+    CCMMAcceleration(const CCMMAcceleration&) {}
+
+    CCMMAcceleration& operator=(const CCMMAcceleration&)
+    {
+        reset();
+
+        return *this;
+    }
+
+    void reset()
+    {
+        iter = 0;
+        history_size = 0;
+        history_index = 0;
+    }
+};
+
+
+// The centroids M are stored as Scalar, which is double or float. Single
+// precision halves the memory traffic of the updates, while the cluster sums
+// XU, the distances between the centroids, the losses, and the within cluster
+// sum of squares are accumulated in double precision, so that the fusion
+// threshold and the convergence criterion keep their meaning and the error in
+// the cluster sums does not grow with the cluster sizes
+template <typename Scalar = double>
+struct CCMMVariables {
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> MatrixX;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> VectorX;
+
+    typedef Eigen::Map<const Eigen::MatrixXd, 0, Eigen::OuterStride<>>
+        MatrixXdMap;
+
+    // Variables used in the minimization. The cluster of each observation,
+    // the cluster sums, and the edges only change when clusters are fused,
+    // in which case they are replaced, so copies of the variables share
+    // them. Until the first fusion, the cluster sums are the observations,
+    // which are not copied and then have to outlive the variables
+    MatrixX M;
+    std::shared_ptr<const Eigen::MatrixXd> XU_fused;
+    const double* XU_data = nullptr;
+    Eigen::Index XU_stride = 0;
+    std::shared_ptr<const Eigen::ArrayXi> membership;
+    Eigen::ArrayXd cluster_sizes;
+    std::shared_ptr<const CCMMEdges> edges;
+    Eigen::ArrayXd distances;
+
+    // Sum of squared distances between the observations and the means of the
+    // clusters they belong to, increases with each fusion
+    double within_ss = 0;
+
+    // State of the acceleration scheme
+    CCMMAcceleration<Scalar> acc;
+
+    // Variables to construct the merge table: the labels of the current
+    // clusters as used in the merge table, the last entry of these variables
+    // in the merge arena, and the number of entries
+    Eigen::ArrayXi cluster_labels;
+    std::shared_ptr<CCMMMergeArena> merges;
+    int merge_head = -1;
+    int merge_table_index = 0;
+
+    // Additional information
+    double loss = 0;
+    int n_iterations = 0;
+    int n_fusions = 0;
+
+
+    template <int P>
+    void update_distances_p(int n_threads)
+    {
+        typedef Eigen::Matrix<Scalar, P, 1> Vector;
+
+        int p = int(M.rows());
+        int n_edges = edges->size();
+        const CCMMEdges& E = *edges;
+
+        distances.resize(n_edges);
+
+        #pragma omp parallel for num_threads(n_threads) schedule(static)
+        for (int e = 0; e < n_edges; e++) {
+            Eigen::Map<const Vector> m_i(M.col(E.i(e)).data(), p);
+            Eigen::Map<const Vector> m_j(M.col(E.j(e)).data(), p);
+
+            distances(e) = (m_i - m_j).template cast<double>().norm();
+        }
+    }
+
+
+    void update_distances(int n_threads = 1,
+                          CCMMInstrumentation* instrumentation = nullptr)
+    {
+        CCMMTimer timer(instrumentation, CCMM_PHASE_DISTANCES);
+
+        // Compute the pairwise distances
+        dispatch_p(int(M.rows()), [&](auto P) {
+            this->template update_distances_p<decltype(P)::value>(n_threads);
+        });
+    }
+
+
+    // Cluster sums U^T X, with one column for each column of M
+    MatrixXdMap XU() const
+    {
+        return MatrixXdMap(XU_data, M.rows(), M.cols(),
+                           Eigen::OuterStride<>(XU_stride));
+    }
+
+
+    void set_cluster_sums(Eigen::MatrixXd&& XU_new)
+    {
+        XU_fused = std::make_shared<const Eigen::MatrixXd>(std::move(XU_new));
+        XU_data = XU_fused->data();
+        XU_stride = XU_fused->outerStride();
+    }
+
+
+    // Centroid of each observation, paper equivalent: UM
+    Eigen::MatrixXd observation_centroids() const
+    {
+        int n = int(membership->size());
+        Eigen::MatrixXd result(M.rows(), n);
+
+        for (int i = 0; i < n; i++) {
+            result.col(i) = M.col((*membership)(i)).template cast<double>();
+        }
+
+        return result;
+    }
+
+
+    CCMMVariables(const Eigen::Ref<const Eigen::MatrixXd>& X,
+                  const Eigen::SparseMatrix<double>& W) :
+                  M(X.template cast<Scalar>())
+    {
+        int n = int(M.cols());
+
+        // The cluster sums start as the observations
+        XU_data = X.data();
+        XU_stride = X.outerStride();
+
+        // Each observation starts in its own cluster
+        membership = std::make_shared<const Eigen::ArrayXi>(
+            Eigen::ArrayXi::LinSpaced(n, 0, n - 1)
+        );
+
+        // Edges based on the nonzero elements of the weight matrix
+        edges = std::make_shared<const CCMMEdges>(W);
+
+        // Array with cluster sizes
+        cluster_sizes = Eigen::ArrayXd::Ones(n);
+
+        // Initialize cluster labels as -1, ..., -n
+        cluster_labels = Eigen::ArrayXi(n);
+        for (int i = 0; i < n; i++) {
+            cluster_labels(i) = -i - 1;
+        }
+
+        // Initialize the merge arena
+        merges = std::make_shared<CCMMMergeArena>(n - 1);
+
+        // Compute the relevant distances based on the nonzero elements of the
+        // weight matrix
+        update_distances();
+    }
+
+
+    double loss_fusions_dense(const CCMMConstants& constants) const
+    {
+        // TODO: Profile later with and without .noalias()
+        Eigen::MatrixXd temp;
+        temp.noalias() = constants.X - observation_centroids();
+
+        // Paper equivalent: ||X - UM||^2
+        return temp.squaredNorm();
+    }
+
+
+    double loss_fusions(const CCMMConstants& constants, double lambda) const
+    {
+        CCMMTimer timer(constants.instrumentation, CCMM_PHASE_LOSS);
+
+        // Paper equivalent: ||X - UM||^2. The squared distances between the
+        // observations and their centroids are split into the distances
+        // between the observations and the cluster means (within_ss) and
+        // the distances between the cluster means U^T X / size and the
+        // centroids, which only requires O(p * c) operations
+        double fit = within_ss;
+
+        if (constants.dense_loss) {
+            fit = loss_fusions_dense(constants);
+        } else {
+            for (int k = 0; k < M.cols(); k++) {
+                fit += cluster_sizes(k) *
+                    (M.col(k).template cast<double>() -
+                     XU().col(k) / cluster_sizes(k))
+                    .squaredNorm();
+            }
+        }
+
+        // Paper equivalent: kappa_eps * ||X - UM||^2
+        double result = constants.kappa_eps * fit;
+
+        // Initialize sum for penalty term
+        double penalty = 0.0;
+
+        // Compute the penalty term
+        for (int e = 0; e < edges->size(); e++) {
+            penalty += edges->w(e) * distances(e);
+        }
+
+        return result + lambda * constants.kappa_pen * penalty;
+    }
+
+
+    template <int P>
+    void gather_update_p(const Eigen::ArrayXd& coefficients,
+                         MatrixX& M_update, Eigen::ArrayXd& diagonal,
+                         int n_threads) const
+    {
+        // Paper equivalent: gamma * (D0 - C0) * M0. Can also be seen as
+        // gamma * abs(C) * M0 as D0 is twice the diagonal of C and all
+        // off-diagonal elements of C are negative. Each column of the update
+        // gathers the contributions of all its edges in a fixed order, so the
+        // result does not depend on the number of threads
+        typedef Eigen::Matrix<Scalar, P, 1> Vector;
+
+        int p = int(M.rows());
+        int c = int(M.cols());
+        const CCMMEdges& E = *edges;
+
+        #pragma omp parallel for num_threads(n_threads) schedule(static)
+        for (int j = 0; j < c; j++) {
+            Eigen::Map<Vector> u_j(M_update.col(j).data(), p);
+            Eigen::Map<const Vector> m_j(M.col(j).data(), p);
+
+            // Edges (j, k) with k < j
+            for (int r = E.row_ptr[j]; r < E.row_ptr[j + 1]; r++) {
+                int e = E.row_idx[r];
+                Eigen::Map<const Vector> m_k(M.col(E.j(e)).data(), p);
+
+                u_j += Scalar(coefficients(e)) * (m_j + m_k);
+                diagonal(j) += coefficients(e);
+            }
+
+            // Edges (i, j) with i > j
+            for (int e = E.col_ptr[j]; e < E.col_ptr[j + 1]; e++) {
+                Eigen::Map<const Vector> m_i(M.col(E.i(e)).data(), p);
+
+                u_j += Scalar(coefficients(e)) * (m_i + m_j);
+                diagonal(j) += coefficients(e);
+            }
+        }
+    }
+
+
+    void anderson_step(MatrixX& M_update, int history)
+    {
+        // M_update is the MM update G(M), the residual is G(M) - M. The
+        // accelerated update is G(M) - delta_M * g, where g minimizes
+        // ||R - delta_R * g|| over the stored history
+        typedef Eigen::Map<const VectorX> VectorMap;
+
+        Eigen::Index size = M_update.size();
+        VectorMap m_update(M_update.data(), size);
+        VectorX residual = m_update - VectorMap(M.data(), size);
+
+        if (acc.iter == 0) {
+            acc.delta_M.resize(size, history);
+            acc.delta_R.resize(size, history);
+        } else {
+            acc.delta_M.col(acc.history_index) =
+                m_update - VectorMap(acc.M_prev.data(), size);
+            acc.delta_R.col(acc.history_index) =
+                residual - VectorMap(acc.R_prev.data(), size);
+
+            acc.history_index = (acc.history_index + 1) % history;
+            acc.history_size = std::min(acc.history_size + 1, history);
+        }
+
+        acc.M_prev = M_update;
+        acc.R_prev = residual;
+        acc.iter++;
+
+        if (acc.history_size > 0) {
+            VectorX g = acc.delta_R.leftCols(acc.history_size)
+                .colPivHouseholderQr().solve(residual);
+
+            if (g.allFinite()) {
+                Eigen::Map<VectorX>(M_update.data(), size) -=
+                    acc.delta_M.leftCols(acc.history_size) * g;
+            }
+        }
+    }
+
+
+    void nesterov_step(MatrixX& M_update)
+    {
+        // Extrapolate from the previous MM update in the direction of the
+        // current one, M_prev holds the previous MM update
+        if (acc.iter > 0) {
+            Scalar beta = Scalar((acc.iter - 1.0) / (acc.iter + 2.0));
+            MatrixX M_extrapolated =
+                M_update + beta * (M_update - acc.M_prev);
+
+            acc.M_prev = M_update;
+            M_update = M_extrapolated;
+        } else {
+            acc.M_prev = M_update;
+        }
+
+        acc.iter++;
+    }
+
+
+    void update(const CCMMConstants& constants, double lambda, int iter)
+    {
+        CCMMTimer timer(constants.instrumentation, CCMM_PHASE_UPDATE);
+
+        double kappa_eps = constants.kappa_eps;
+        double kappa_pen = constants.kappa_pen;
+        int n_threads = constants.n_threads;
+
+        // Due to Eigen following colmajor conventions, this function computes
+        // the transpose of the update that is shown in the paper.
+        // Number of variables (p) and current number of clusters (c)
+        int p = int(M.rows());
+        int c = int(M.cols());
+
+        // Initialize M_update
+        MatrixX M_update = MatrixX::Zero(p, c);
+
+        // Paper equivalent: diagonal of U^T U + gamma * D0
+        Eigen::ArrayXd diagonal = Eigen::ArrayXd::Zero(c);
+
+        // Precompute lambda * kappa_pen / (2 * kappa_eps)
+        double gamma = lambda * kappa_pen / (2 * kappa_eps);
+
+        // Compute gamma * w_ij / ||m_i - m_j|| for each edge
+        Eigen::ArrayXd coefficients = gamma * edges->w / distances.max(1e-6);
+
+        // Paper equivalent: gamma * (D0 - C0) * M0
+        dispatch_p(p, [&](auto P) {
+            this->template gather_update_p<decltype(P)::value>(
+                coefficients, M_update, diagonal, n_threads
+            );
+        });
+
+        // Paper equivalent: add U^t * X to the update
+        M_update += XU().template cast<Scalar>();
+
+        // Finish the diagonal matrix and multiply the update with its inverse
+        diagonal = 2 * diagonal + cluster_sizes;
+
+        for (int i = 0; i < c; i++) {
+            M_update.col(i) /= Scalar(diagonal(i));
+        }
+
+        // Apply acceleration
+        if (iter > constants.burn_in) {
+            switch (constants.acceleration) {
+            case ACCELERATION_DOUBLING:
+                M_update = 2 * M_update - M;
+                break;
+            case ACCELERATION_ANDERSON:
+                anderson_step(M_update, constants.history);
+                break;
+            case ACCELERATION_NESTEROV:
+                nesterov_step(M_update);
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Set new M
+        M = M_update;
+
+        // Update pairwise distances
+        update_distances(n_threads, constants.instrumentation);
+    }
+
+
+    Eigen::ArrayXi fusion_candidates(double eps_fusions) const
+    {
+        // Preliminaries
+        int c = int(M.cols());
+        DisjointSet djs(c);
+
+        // Find fusion candidates, clusters connected through a chain of edges
+        // shorter than eps_fusions end up in the same set
+        for (int e = 0; e < edges->size(); e++) {
+            if (distances(e) <= eps_fusions) {
+                djs.merge(edges->i(e), edges->j(e));
+            }
+        }
+
+        // Assign consecutive labels to the sets, in order of their smallest
+        // member
+        Eigen::ArrayXi cluster_membership(c);
+        std::vector<int> labels(c, -1);
+        int cluster = 0;
+
+        for (int k = 0; k < c; k++) {
+            int root = djs.root(k);
+
+            if (labels[root] < 0) {
+                labels[root] = cluster;
+                cluster++;
+            }
+
+            cluster_membership(k) = labels[root];
+        }
+
+        return cluster_membership;
+    }
+
+
+    bool fuse(double eps_fusions, double lambda, int n_threads,
+              CCMMInstrumentation* instrumentation = nullptr)
+    {
+        CCMMTimer timer(instrumentation, CCMM_PHASE_FUSE);
+
+        // Return if there are no eligible fusions
+        if ((distances > eps_fusions).all()) return false;
+
+        // New cluster of each of the current clusters
+        Eigen::ArrayXi fused = fusion_candidates(eps_fusions);
+        int c = int(fused.size());
+        int c_new = fused.maxCoeff() + 1;
+
+        if (c > c_new) {
+            // Computation of the edges between the new clusters, paper
+            // equivalent: lower triangular part of U^T W U
+            edges = std::make_shared<const CCMMEdges>(
+                edges->contract(fused, c_new)
+            );
+
+            // New cluster sums XU, cluster sizes, and M
+            Eigen::MatrixXd XU_new = Eigen::MatrixXd::Zero(M.rows(), c_new);
+            Eigen::ArrayXd cluster_sizes_new = Eigen::ArrayXd::Zero(c_new);
+            MatrixX M_new = MatrixX::Zero(M.rows(), c_new);
+
+            // Array to hold the number of clusters merged into a new cluster
+            // for the purpose of constructing new merge table entries
+            Eigen::ArrayXi merge_cluster_sizes = Eigen::ArrayXi::Zero(c_new);
+
+            for (int i = 0; i < c; i++) {
+                int j = fused(i);
+
+                // Set new cluster size and sum
+                cluster_sizes_new(j) += cluster_sizes(i);
+                XU_new.col(j) += XU().col(i);
+
+                // Set new columns of M
+                M_new.col(j) += M.col(i) * Scalar(cluster_sizes(i));
+
+                // Count the number of clusters from the previous clustering
+                // that make up each new cluster
+                merge_cluster_sizes(j) += 1;
+            }
+
+            // Compute weighted average for columns of M
+            for (int i = 0; i < M_new.cols(); i++) {
+                M_new.col(i) /= Scalar(cluster_sizes_new(i));
+            }
+
+            // Increase of the within cluster sum of squares: the squared
+            // distances between the means of the fused clusters and the mean
+            // of the new cluster, weighted by the cluster sizes
+            for (int i = 0; i < c; i++) {
+                int j = fused(i);
+                if (merge_cluster_sizes(j) < 2) continue;
+
+                within_ss += cluster_sizes(i) *
+                    (XU().col(i) / cluster_sizes(i) -
+                     XU_new.col(j) / cluster_sizes_new(j)).squaredNorm();
+            }
+
+            // Order the current clusters by their new cluster, in order of
+            // their index within each new cluster
+            std::vector<int> offsets(c_new + 1, 0);
+            for (int j = 0; j < c_new; j++) {
+                offsets[j + 1] = offsets[j] + merge_cluster_sizes(j);
+            }
+
+            std::vector<int> order(c);
+            std::vector<int> position(offsets.begin(), offsets.end() - 1);
+            for (int i = 0; i < c; i++) {
+                order[position[fused(i)]++] = i;
+            }
+
+            // Adding entries to the merge table, the clusters that make up a
+            // new cluster are merged one by one
+            Eigen::ArrayXi cluster_labels_new(c_new);
+
+            for (int j = 0; j < c_new; j++) {
+                int label = cluster_labels(order[offsets[j]]);
+
+                for (int k = offsets[j] + 1; k < offsets[j + 1]; k++) {
+                    // Set the merge table entry and record the height at
+                    // which the merge occurred
+                    merge_head = merges->append(
+                        label, cluster_labels(order[k]), lambda, merge_head
+                    );
+
+                    merge_table_index++;
+
+                    // The merged clusters are referred to by the index of
+                    // the entry
+                    label = merge_table_index;
+                }
+
+                cluster_labels_new(j) = label;
+            }
+
+            cluster_labels = cluster_labels_new;
+
+            // Relabel the observations with their new clusters
+            Eigen::ArrayXi membership_new(membership->size());
+            for (Eigen::Index i = 0; i < membership->size(); i++) {
+                membership_new(i) = fused((*membership)(i));
+            }
+            membership = std::make_shared<const Eigen::ArrayXi>(
+                std::move(membership_new)
+            );
+
+            // Set M, the cluster sums, and cluster_sizes to their updates
+            M = M_new;
+            set_cluster_sums(std::move(XU_new));
+            cluster_sizes = cluster_sizes_new;
+
+            // Set distances based on the new clusters
+            update_distances(n_threads, instrumentation);
+
+            // The dimensions of M have changed, so the acceleration starts
+            // over
+            acc.reset();
+        }
+
+        return c > c_new;
+    }
+
+
+    bool has_converged(double l_old, double l_new, double l_target,
+                       double eps_conv, bool use_target)
+    {
+        if (!use_target) {
+            return (l_old - l_new) / l_new <= eps_conv;
+        }
+
+        return (l_new - l_target) / l_target <= eps_conv;
+    }
+
+
+    std::tuple<Eigen::VectorXd, Eigen::VectorXd>
+    minimize(const CCMMConstants& constants, double lambda, double loss_target,
+             bool save_convergence_norms, bool check_interrupt = true)
+    {
+        CCMMTimer timer(constants.instrumentation, CCMM_PHASE_MINIMIZE);
+
+        // The numbers of edges and clusters only decrease while minimizing
+        if (constants.instrumentation != nullptr) {
+            constants.instrumentation->record_size(int(edges->size()),
+                                                   int(M.cols()));
+        }
+
+        // Preliminaries
+        int iter = 0;
+        int fusions = 0;
+        double loss_1 = loss_fusions(constants, lambda);
+        double loss_0 = (2 + constants.eps_conv) * loss_1;
+
+        // Do not extrapolate from the iterates for the previous lambda
+        acc.reset();
+
+        // Track loss value during iterations
+        Eigen::VectorXd losses(constants.max_iter + 1);
+        losses(0) = loss_1;
+
+        // Track difference between iterates
+        Eigen::VectorXd delta_iterates;
+        Eigen::MatrixXd A0;
+        Eigen::MatrixXd A1;
+
+        // Only compute A0 and allocate resources if the differences are tracked
+        if (save_convergence_norms) {
+            // Ensure that delta_iterates is properly sized
+            delta_iterates.resize(constants.max_iter);
+
+            // Compute A0
+            A0 = observation_centroids();
+        }
+
+        while (!has_converged(loss_0, loss_1, loss_target,
+                              constants.eps_conv, constants.use_target) &&
+                                  (iter < constants.max_iter) && lambda > 0) {
+            // Compute update for M
+            update(constants, lambda, iter);
+            int n_clusters = int(M.cols());
+
+            // Fuse all clusters that are connected through edges shorter
+            // than eps_fusions
+            bool clusters_fused = fuse(constants.eps_fusions, lambda,
+                                       constants.n_threads,
+                                       constants.instrumentation);
+
+            // Update loss values, if cluster fusions occurred, set the
+            // previous loss to a value such that at least one more minimizing
+            // iteration is performed
+            if (clusters_fused) {
+                fusions += n_clusters - int(M.cols());
+                loss_1 = loss_fusions(constants, lambda);
+                loss_0 = (2 + constants.eps_conv) * loss_1;
+            } else {
+                loss_0 = loss_1;
+                loss_1 = loss_fusions(constants, lambda);
+
+                // Anderson and Nesterov acceleration do not guarantee a
+                // decrease of the loss, if it increased, restart the
+                // acceleration and perform at least one more iteration
+                if (loss_1 > loss_0 &&
+                        (constants.acceleration == ACCELERATION_ANDERSON ||
+                         constants.acceleration == ACCELERATION_NESTEROV)) {
+                    acc.reset();
+                    loss_0 = (2 + constants.eps_conv) * loss_1;
+                }
+            }
+
+            // Check for user interrupt, this is only allowed on the main
+            // thread
+            if (check_interrupt) {
+                constants.hooks.check_interrupt();
+            }
+
+            iter++;
+
+            // Add loss to the vector keeping track of the loss values
+            losses(iter) = loss_1;
+
+            // If tracking, compute the norm of the difference between the
+            // iterates of A
+            if (save_convergence_norms) {
+                // Compute updated version of A
+                A1 = observation_centroids();
+
+                // Compute the difference between A0 and A1
+                delta_iterates(iter - 1) = (A0 - A1).norm();
+
+                // Update A0
+                A0 = A1;
+            }
+        }
+
+        // Minimization result
+        n_iterations = iter;
+        n_fusions = fusions;
+        loss = loss_1;
+
+        // Resize the losses vector
+        losses.conservativeResize(iter + 1);
+
+        // Resize the iterate differences vector
+        if (save_convergence_norms) {
+            delta_iterates.conservativeResize(iter);
+        }
+
+        return std::make_tuple(losses, delta_iterates);
+    }
+
+
+    int num_clusters()
+    {
+        int result = int(M.cols());
+
+        return result;
+    }
+};
+
+
+struct CCMMResults {
+    // Memory for the arrays below, which are views into buffers of the
+    // storage. Copies of the results share the storage
+    std::shared_ptr<CCMMStorage> storage;
+
+    // Clusterpath and info variables, the clusterpath is stored compactly as
+    // the cluster centroids for each lambda together with the number of
+    // entries of the merge table that describe the clustering. The centroids
+    // are appended to a buffer that grows when needed
+    Eigen::Map<Eigen::ArrayXXd> clusterpath{nullptr, 0, 0};
+    Eigen::Map<Eigen::ArrayXi> clusterpath_merges{nullptr, 0};
+    double* centroids = nullptr;
+    Eigen::Index centroids_size = 0;
+    Eigen::Index centroids_capacity = 0;
+    Eigen::Map<Eigen::ArrayXXd> info_d{nullptr, 0, 0};
+    Eigen::Map<Eigen::ArrayXXi> info_i{nullptr, 0, 0};
+    Eigen::Map<Eigen::ArrayXi> fusions{nullptr, 0};
+    bool save_clusterpath;
+    int info_index;
+    int n_vars;
+
+    // Merge table variables
+    Eigen::Map<Eigen::ArrayXXi> merge{nullptr, 0, 0};
+    Eigen::Map<Eigen::ArrayXd> height{nullptr, 0};
+    int merge_index;
+
+    // Losses and norms of the differences between the iterates for each
+    // minimization, only kept if requested
+    std::list<Eigen::VectorXd> losses;
+    std::list<Eigen::VectorXd> convergence_norms;
+
+    // Number of minimizations in each phase of ccmm_clustering and the number
+    // of targets for the number of clusters that were found
+    int phase_1_instances = 0;
+    int phase_2_instances = 0;
+    int targets_found = 0;
+
+    CCMMResults(int n_obs, int n_vars, int n_lambdas, bool save_clusterpath,
+                std::shared_ptr<CCMMStorage> storage = nullptr) :
+                storage(storage ? storage : std::make_shared<CCMMStorage>()),
+                save_clusterpath(save_clusterpath), n_vars(n_vars)
+    {
+        view(CCMM_OUTPUT_MERGE, merge, 2, n_obs - 1);
+        view(CCMM_OUTPUT_HEIGHT, height, n_obs - 1, 1);
+        view(CCMM_OUTPUT_INFO_D, info_d, 2, n_lambdas);
+        view(CCMM_OUTPUT_INFO_I, info_i, 2, n_lambdas);
+        view(CCMM_OUTPUT_FUSIONS, fusions, n_lambdas, 1);
+        merge_index = 0;
+        info_index = 0;
+
+        if (save_clusterpath) {
+            view(CCMM_OUTPUT_CLUSTERPATH_MERGES, clusterpath_merges, n_lambdas,
+                 1);
+
+            // Room for the centroids of the first lambda, at which each
+            // observation is usually its own cluster
+            reserve_centroids(Eigen::Index(n_obs) * n_vars);
+        }
+    }
+
+    // The arrays are views, assigning them would copy the values
+    CCMMResults(const CCMMResults&) = default;
+    CCMMResults& operator=(const CCMMResults&) = delete;
+
+    // Point map to a new buffer of the storage for output with the given
+    // dimensions, copying the first size values of the current buffer
+    template <typename T>
+    void view(int output, Eigen::Map<T>& map, Eigen::Index rows,
+              Eigen::Index cols, Eigen::Index size = 0)
+    {
+        typename T::Scalar* data;
+        storage->allocate(output, rows * cols, data);
+        std::copy(map.data(), map.data() + size, data);
+
+        // A map cannot be assigned to point to other memory
+        new (&map) Eigen::Map<T>(data, rows, cols);
+    }
+
+    void reserve_centroids(Eigen::Index capacity)
+    {
+        double* data;
+        storage->allocate(CCMM_OUTPUT_CLUSTERPATH, capacity, data);
+        std::copy(centroids, centroids + centroids_size, data);
+
+        centroids = data;
+        centroids_capacity = capacity;
+    }
+
+    template <typename Scalar>
+    void add_results(const CCMMVariables<Scalar>& variables, double lambda)
+    {
+        // Add entries to the info array
+        info_d(0, info_index) = lambda;
+        info_d(1, info_index) = variables.loss;
+        info_i(0, info_index) = variables.n_iterations;
+        info_i(1, info_index) = int(variables.M.cols());
+        fusions(info_index) = variables.n_fusions;
+
+        // Add entries to the merge table, walking back from the last entry
+        // that was added by the variables
+        const CCMMMergeArena& arena = *variables.merges;
+        int k = variables.merge_head;
+
+        for (int i = variables.merge_table_index - 1; i >= merge_index; i--) {
+            merge(0, i) = arena.a[k];
+            merge(1, i) = arena.b[k];
+            height(i) = arena.height[k];
+
+            k = arena.prev[k];
+        }
+
+        merge_index = variables.merge_table_index;
+
+        // Store the centroids in double precision, the columns of M are
+        // ordered by the smallest observation in each cluster, so together
+        // with the merge table they determine the location of each
+        // observation
+        if (save_clusterpath) {
+            Eigen::Index size = variables.M.size();
+
+            // The number of clusters does not increase from one result to
+            // the next, which bounds the room needed for the remaining ones
+            if (centroids_size + size > centroids_capacity) {
+                Eigen::Index bound =
+                    centroids_size + size * (info_d.cols() - info_index);
+
+                reserve_centroids(std::min(
+                    std::max(2 * centroids_capacity, centroids_size + size),
+                    bound
+                ));
+            }
+
+            std::copy(variables.M.data(), variables.M.data() + size,
+                      centroids + centroids_size);
+            centroids_size += size;
+            clusterpath_merges(info_index) = merge_index;
+        }
+
+        info_index++;
+    }
+
+    void finalize()
+    {
+        // Shrink the arrays to the entries that were filled, which only
+        // copies the arrays that are not full
+        if (merge_index < merge.cols()) {
+            view(CCMM_OUTPUT_MERGE, merge, 2, merge_index, 2 * merge_index);
+            view(CCMM_OUTPUT_HEIGHT, height, merge_index, 1, merge_index);
+        }
+
+        if (info_index < info_d.cols()) {
+            view(CCMM_OUTPUT_INFO_D, info_d, 2, info_index, 2 * info_index);
+            view(CCMM_OUTPUT_INFO_I, info_i, 2, info_index, 2 * info_index);
+            view(CCMM_OUTPUT_FUSIONS, fusions, info_index, 1, info_index);
+
+            if (save_clusterpath) {
+                view(CCMM_OUTPUT_CLUSTERPATH_MERGES, clusterpath_merges,
+                     info_index, 1, info_index);
+            }
+        }
+
+        if (centroids_size < centroids_capacity) {
+            reserve_centroids(centroids_size);
+        }
+
+        // Without a clusterpath, the storage still holds empty outputs
+        if (!save_clusterpath) {
+            view(CCMM_OUTPUT_CLUSTERPATH_MERGES, clusterpath_merges, 0, 1);
+            reserve_centroids(0);
+        }
+
+        new (&clusterpath) Eigen::Map<Eigen::ArrayXXd>(
+            centroids, n_vars, n_vars > 0 ? centroids_size / n_vars : 0
+        );
+    }
+};
+
+
+// Expand the compact clusterpath for a single lambda: replay the first
+// n_merges entries of the merge table and give each observation the centroid
+// of its cluster. The centroids are ordered by the smallest observation in
+// each cluster
+inline Eigen::MatrixXd
+clusterpath_coordinates(const Eigen::MatrixXd& centroids,
+                        const Eigen::MatrixXi& merge, int n_obs, int n_merges)
+{
+    DisjointSet clusters(n_obs);
+
+    // Keep track of an observation in each merged cluster
+    std::vector<int> members(n_merges);
+
+    for (int i = 0; i < n_merges; i++) {
+        int a = merge(i, 0) < 0 ? -merge(i, 0) - 1 : members[merge(i, 0) - 1];
+        int b = merge(i, 1) < 0 ? -merge(i, 1) - 1 : members[merge(i, 1) - 1];
+
+        clusters.merge(a, b);
+        members[i] = a;
+    }
+
+    // Label the clusters in order of their smallest observation
+    std::vector<int> labels(n_obs, -1);
+    Eigen::MatrixXd result(n_obs, centroids.cols());
+    int n_labels = 0;
+
+    for (int i = 0; i < n_obs; i++) {
+        int root = clusters.root(i);
+
+        if (labels[root] < 0) {
+            labels[root] = n_labels++;
+        }
+
+        result.row(i) = centroids.row(labels[root]);
+    }
+
+    return result;
+}
+
+// Cut the merge table at each number of clusters in n_clusters in a single
+// sweep over the merges. Column k of labels holds the cluster label of each
+// observation after the first n_obs - n_clusters(k) merges, where clusters
+// that are single observations come first in the order of the observations,
+// followed by the merged clusters in the order in which they were formed.
+// The same ordering of the clusters after the last merge, with the
+// observations in each merged cluster in the order in which they were added,
+// gives the order of the observations for a dendrogram
+inline void cut_merge_table(const Eigen::MatrixXi& merge, int n_obs,
+                            const Eigen::VectorXi& n_clusters,
+                            Eigen::MatrixXi& labels, Eigen::VectorXi& order)
+{
+    int n_merges = int(merge.rows());
+    int n_keys = n_obs + n_merges;
+    DisjointSet clusters(n_obs);
+
+    // Key of the cluster of each root that determines the order of the
+    // clusters: the observation itself or n_obs plus the index of the merge
+    std::vector<int> key(n_obs);
+
+    // First and last observation of the cluster of each root, and the next
+    // observation in the same cluster
+    std::vector<int> first(n_obs);
+    std::vector<int> last(n_obs);
+    std::vector<int> next(n_obs, -1);
+
+    for (int i = 0; i < n_obs; i++) {
+        key[i] = i;
+        first[i] = i;
+        last[i] = i;
+    }
+
+    // Keep track of an observation in each merged cluster
+    std::vector<int> members(n_merges);
+
+    // Cuts ordered by the number of merges they require
+    std::vector<int> cuts(n_clusters.size());
+    for (int k = 0; k < int(cuts.size()); k++) cuts[k] = k;
+
+    std::sort(cuts.begin(), cuts.end(), [&](int a, int b) {
+        return n_clusters(a) > n_clusters(b);
+    });
+
+    // Numbers of clusters that are not reached are labeled -1
+    labels.setConstant(n_obs, n_clusters.size(), -1);
+    std::vector<int> rank(n_keys);
+    auto cut = cuts.begin();
+
+    for (int i = 0; i <= n_merges; i++) {
+        // Label the observations for the cuts after i merges, the keys of the
+        // remaining clusters are ranked by counting them
+        for (; cut != cuts.end() && n_obs - n_clusters(*cut) <= i; cut++) {
+            std::fill(rank.begin(), rank.end(), 0);
+
+            for (int j = 0; j < n_obs; j++) {
+                if (clusters.root(j) == j) rank[key[j]] = 1;
+            }
+
+            for (int j = 0, c = 0; j < n_keys; j++) {
+                int present = rank[j];
+                rank[j] = c;
+                c += present;
+            }
+
+            for (int j = 0; j < n_obs; j++) {
+                labels(j, *cut) = rank[key[clusters.root(j)]];
+            }
+        }
+
+        if (i == n_merges) break;
+
+        int a = merge(i, 0) < 0 ? -merge(i, 0) - 1 : members[merge(i, 0) - 1];
+        int b = merge(i, 1) < 0 ? -merge(i, 1) - 1 : members[merge(i, 1) - 1];
+        int root_a = clusters.root(a);
+        int root_b = clusters.root(b);
+
+        // Append the observations of b to those of a
+        next[last[root_a]] = first[root_b];
+        int first_new = first[root_a];
+        int last_new = last[root_b];
+
+        clusters.merge(a, b);
+        int root = clusters.root(a);
+
+        key[root] = n_obs + i;
+        first[root] = first_new;
+        last[root] = last_new;
+        members[i] = a;
+    }
+
+    // Walk through the observations of the remaining clusters in the order
+    // of their keys
+    std::vector<int> roots(n_keys, -1);
+
+    for (int j = 0; j < n_obs; j++) {
+        if (clusters.root(j) == j) roots[key[j]] = j;
+    }
+
+    order.resize(n_obs);
+    int index = 0;
+
+    for (int root : roots) {
+        if (root < 0) continue;
+
+        for (int j = first[root]; j >= 0; j = next[j]) {
+            order(index++) = j;
+        }
+    }
+}
+
+#endif // CCMMR_SOLVER_H
@@ -0,0 +1,57 @@
+#ifndef CCMMR_STORAGE_H
+#define CCMMR_STORAGE_H
+
+#include <Eigen/Eigen>
+#include <vector>
+
+
+// Arrays of CCMMResults, for which memory is requested from a CCMMStorage
+enum CCMMOutput {
+    CCMM_OUTPUT_CLUSTERPATH = 0,
+    CCMM_OUTPUT_CLUSTERPATH_MERGES = 1,
+    CCMM_OUTPUT_MERGE = 2,
+    CCMM_OUTPUT_HEIGHT = 3,
+    CCMM_OUTPUT_INFO_D = 4,
+    CCMM_OUTPUT_INFO_I = 5,
+    CCMM_OUTPUT_FUSIONS = 6,
+    CCMM_N_OUTPUTS = 7
+};
+
+
+// Memory for the arrays of the results. Requesting memory for an output again
+// replaces its buffer, while the previous buffer stays valid until the next
+// request so that its contents can be copied. By default the buffers are
+// vectors owned by the storage, hosts such as the R package can override the
+// allocation to write the results directly into memory they own
+struct CCMMStorage {
+    virtual ~CCMMStorage() = default;
+
+    virtual void allocate(int output, Eigen::Index size, double*& data)
+    {
+        replace(doubles[output], size, data);
+    }
+
+    virtual void allocate(int output, Eigen::Index size, int*& data)
+    {
+        replace(ints[output], size, data);
+    }
+
+private:
+    std::vector<double> doubles[CCMM_N_OUTPUTS][2];
+    std::vector<int> ints[CCMM_N_OUTPUTS][2];
+
+    template <typename T>
+    static void replace(std::vector<T> (&buffers)[2], Eigen::Index size,
+                        T*& data)
+    {
+        // The current buffer becomes the previous one, the memory of the
+        // previous buffer is released before the new one is allocated
+        buffers[0].swap(buffers[1]);
+        std::vector<T>().swap(buffers[1]);
+        buffers[1].resize(size);
+
+        data = buffers[1].data();
+    }
+};
+
+#endif // CCMMR_STORAGE_H
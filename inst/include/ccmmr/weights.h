@@ -0,0 +1,269 @@
+#ifndef CCMMR_WEIGHTS_H
+#define CCMMR_WEIGHTS_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "knn.h"
+
+
+// Sparse weight matrix in dictionary of keys format and the mean squared
+// distance used to scale the weights
+struct CCMMWeights {
+    Eigen::ArrayXXi keys;
+    Eigen::ArrayXd values;
+    double msd;
+};
+
+
+// Mean squared distance between the objects in the columns of X. The mean
+// over all pairs equals 2 / (n - 1) times the sum of the squared distances
+// between the objects and their mean, which is computed in two passes to avoid
+// cancellation. Both passes sum blocks of objects in parallel and add the
+// block sums in a fixed order, so the result does not depend on the number of
+// threads
+inline double mean_squared_distance(const Eigen::MatrixXd& X, int n_threads = 1)
+{
+    const Eigen::Index block_size = 4096;
+    Eigen::Index n = X.cols();
+    Eigen::Index n_blocks = (n + block_size - 1) / block_size;
+
+    // Mean of the objects
+    Eigen::MatrixXd block_sums(X.rows(), n_blocks);
+
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (Eigen::Index b = 0; b < n_blocks; b++) {
+        Eigen::Index start = b * block_size;
+        Eigen::Index size = std::min(block_size, n - start);
+
+        block_sums.col(b) = X.middleCols(start, size).rowwise().sum();
+    }
+
+    Eigen::VectorXd mean = block_sums.rowwise().sum() / double(n);
+
+    // Sum of the squared distances to the mean
+    Eigen::VectorXd block_ss(n_blocks);
+
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (Eigen::Index b = 0; b < n_blocks; b++) {
+        Eigen::Index start = b * block_size;
+        Eigen::Index size = std::min(block_size, n - start);
+
+        block_ss(b) = (X.middleCols(start, size).colwise() - mean).squaredNorm();
+    }
+
+    return 2 * block_ss.sum() / double(n - 1);
+}
+
+
+// Weights exp(-phi * d_ij^2) between each object and its k nearest neighbors
+// given by indices and distances, optionally added to a symmetric circulant
+// and scaled by the mean squared distance between the objects, which is
+// computed on n_threads threads
+inline CCMMWeights knn_weights(const Eigen::MatrixXd& X,
+                               const Eigen::MatrixXi& indices,
+                               const Eigen::MatrixXd& distances,
+                               const double phi,
+                               const int k,
+                               const bool sym_circ,
+                               const bool scale,
+                               const int n_threads)
+{
+    // Preliminaries
+    int n = int(X.cols());
+
+    // Array of keys and values, 2*(k+2)*n is a loose upper bound on the number
+    // of nonzero weights, trimming happens later. The keys are object indices
+    // and fit in int, their number may not
+    Eigen::Index max_keys = 2 * (Eigen::Index(k) + 2) * n;
+    Eigen::ArrayXXi keys(2, max_keys);
+    Eigen::ArrayXd values(max_keys);
+
+    // Fill keys
+    Eigen::Index key_count = 0;
+    for (int i = 0; i < indices.cols(); i++) {
+        for (int j = 0; j < indices.rows(); j++) {
+            if (i != indices(j, i)) {
+                keys(0, key_count) = i;
+                keys(1, key_count) = indices(j, i);
+                keys(0, key_count + 1) = indices(j, i);
+                keys(1, key_count + 1) = i;
+
+                values(key_count) = distances(j, i);
+                values(key_count + 1) = distances(j, i);
+
+                key_count += 2;
+            }
+        }
+    }
+
+    // Apply symmetric circulant
+    if (sym_circ) {
+        for (int i = 0; i < n; i++) {
+            int j = (i + 1) % n;
+            double d_ij = (X.col(i) - X.col(j)).norm();
+
+            keys(0, key_count) = i;
+            keys(1, key_count) = j;
+            keys(0, key_count + 1) = j;
+            keys(1, key_count + 1) = i;
+
+            values(key_count) = d_ij;
+            values(key_count + 1) = d_ij;
+
+            key_count += 2;
+        }
+    }
+
+    // Trim unused key/value pairs
+    keys.conservativeResize(2, key_count);
+    values.conservativeResize(key_count);
+
+    // Compute mean squared distance
+    double msd = 0;
+    if (scale) {
+        msd = mean_squared_distance(X, n_threads);
+    }
+
+    // Compute weights
+    values = values.square();
+    if (scale) {
+        values /= msd;
+    }
+    values = Eigen::exp(-phi * values);
+
+    CCMMWeights result;
+    result.keys = keys;
+    result.values = values;
+    result.msd = msd;
+
+    return result;
+}
+
+// Weights exp(-phi * d_ij^2) between each object and its k nearest neighbors,
+// which are found with a k-d tree, optionally added to a symmetric circulant
+// and scaled by the mean squared distance between the objects. Unlike
+// knn_weights, each pair (i, j) appears once in each direction and the keys
+// are sorted by j and then by i
+inline CCMMWeights native_knn_weights(const Eigen::MatrixXd& X,
+                                      const double phi,
+                                      const int k,
+                                      const bool sym_circ,
+                                      const bool scale,
+                                      const int n_threads)
+{
+    // Preliminaries
+    int n = int(X.cols());
+
+    // Nearest neighbors, including each object itself
+    Eigen::MatrixXi indices;
+    Eigen::MatrixXd distances;
+    KDTree tree(X, 16, n_threads);
+    tree.query(k + 1, indices, distances, n_threads);
+
+    // Number of keys in each column, counting duplicates. Column i holds the
+    // neighbors of i and the objects that have i as their neighbor
+    std::vector<Eigen::Index> col_ptr(n + 1, 0);
+
+    for (int i = 0; i < n; i++) {
+        for (int r = 0; r < indices.rows(); r++) {
+            int j = indices(r, i);
+
+            if (i == j) continue;
+
+            col_ptr[i + 1]++;
+            col_ptr[j + 1]++;
+        }
+    }
+
+    if (sym_circ && n > 1) {
+        for (int i = 0; i < n; i++) {
+            col_ptr[i + 1]++;
+            col_ptr[(i + 1) % n + 1]++;
+        }
+    }
+
+    for (int i = 0; i < n; i++) col_ptr[i + 1] += col_ptr[i];
+
+    // Fill the rows and distances of each column
+    std::vector<std::pair<int, double>> entries(col_ptr[n]);
+    std::vector<Eigen::Index> fill(col_ptr.begin(), col_ptr.end() - 1);
+
+    for (int i = 0; i < n; i++) {
+        for (int r = 0; r < indices.rows(); r++) {
+            int j = indices(r, i);
+
+            if (i == j) continue;
+
+            entries[fill[i]++] = {j, distances(r, i)};
+            entries[fill[j]++] = {i, distances(r, i)};
+        }
+    }
+
+    if (sym_circ && n > 1) {
+        for (int i = 0; i < n; i++) {
+            int j = (i + 1) % n;
+            double d_ij = (X.col(i) - X.col(j)).norm();
+
+            entries[fill[i]++] = {j, d_ij};
+            entries[fill[j]++] = {i, d_ij};
+        }
+    }
+
+    // Sort each column by row and remove duplicate rows, a pair that is
+    // found from both sides has the same distance
+    std::vector<Eigen::Index> col_size(n);
+
+    #pragma omp parallel for num_threads(n_threads) schedule(dynamic, 1024)
+    for (int i = 0; i < n; i++) {
+        auto begin = entries.begin() + col_ptr[i];
+        auto end = entries.begin() + col_ptr[i + 1];
+
+        std::sort(begin, end);
+        end = std::unique(begin, end,
+            [](const std::pair<int, double>& a,
+               const std::pair<int, double>& b) { return a.first == b.first; }
+        );
+
+        col_size[i] = end - begin;
+    }
+
+    // Offsets of the columns after removing the duplicates
+    std::vector<Eigen::Index> offset(n + 1, 0);
+    for (int i = 0; i < n; i++) offset[i + 1] = offset[i] + col_size[i];
+
+    Eigen::ArrayXXi keys(2, offset[n]);
+    Eigen::ArrayXd values(offset[n]);
+
+    #pragma omp parallel for num_threads(n_threads) schedule(static)
+    for (int i = 0; i < n; i++) {
+        for (Eigen::Index e = 0; e < col_size[i]; e++) {
+            keys(0, offset[i] + e) = entries[col_ptr[i] + e].first;
+            keys(1, offset[i] + e) = i;
+            values(offset[i] + e) = entries[col_ptr[i] + e].second;
+        }
+    }
+
+    // Compute mean squared distance
+    double msd = 0;
+    if (scale) {
+        msd = mean_squared_distance(X, n_threads);
+    }
+
+    // Compute weights
+    values = values.square();
+    if (scale) {
+        values /= msd;
+    }
+    values = Eigen::exp(-phi * values);
+
+    CCMMWeights result;
+    result.keys = keys;
+    result.values = values;
+    result.msd = msd;
+
+    return result;
+}
+
+#endif // CCMMR_WEIGHTS_H
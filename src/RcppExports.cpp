@@ -11,13 +11,40 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// expand_clusterpath
+Eigen::MatrixXd expand_clusterpath(const Eigen::MatrixXd& centroids, const Eigen::MatrixXi& merge, int n_obs, int n_merges);
+RcppExport SEXP _CCMMR_expand_clusterpath(SEXP centroidsSEXP, SEXP mergeSEXP, SEXP n_obsSEXP, SEXP n_mergesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type centroids(centroidsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type merge(mergeSEXP);
+    Rcpp::traits::input_parameter< int >::type n_obs(n_obsSEXP);
+    Rcpp::traits::input_parameter< int >::type n_merges(n_mergesSEXP);
+    rcpp_result_gen = Rcpp::wrap(expand_clusterpath(centroids, merge, n_obs, n_merges));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cut_clusterpath
+Rcpp::List cut_clusterpath(const Eigen::MatrixXi& merge, int n_obs, const Eigen::VectorXi& n_clusters);
+RcppExport SEXP _CCMMR_cut_clusterpath(SEXP mergeSEXP, SEXP n_obsSEXP, SEXP n_clustersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type merge(mergeSEXP);
+    Rcpp::traits::input_parameter< int >::type n_obs(n_obsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type n_clusters(n_clustersSEXP);
+    rcpp_result_gen = Rcpp::wrap(cut_clusterpath(merge, n_obs, n_clusters));
+    return rcpp_result_gen;
+END_RCPP
+}
 // convex_clusterpath
-Rcpp::List convex_clusterpath(const Eigen::MatrixXd& X, const Eigen::MatrixXi& W_idx, const Eigen::VectorXd& W_val, const Eigen::VectorXd& lambdas, const Eigen::VectorXd& target_losses, double eps_conv, double eps_fusions, bool scale, bool save_clusterpath, bool use_target, bool save_losses, bool save_convergence_norms, int burnin_iter, int max_iter_conv);
-RcppExport SEXP _CCMMR_convex_clusterpath(SEXP XSEXP, SEXP W_idxSEXP, SEXP W_valSEXP, SEXP lambdasSEXP, SEXP target_lossesSEXP, SEXP eps_convSEXP, SEXP eps_fusionsSEXP, SEXP scaleSEXP, SEXP save_clusterpathSEXP, SEXP use_targetSEXP, SEXP save_lossesSEXP, SEXP save_convergence_normsSEXP, SEXP burnin_iterSEXP, SEXP max_iter_convSEXP) {
+Rcpp::List convex_clusterpath(const Eigen::Map<Eigen::MatrixXd> X, const Eigen::MatrixXi& W_idx, const Eigen::VectorXd& W_val, const Eigen::VectorXd& lambdas, const Eigen::VectorXd& target_losses, double eps_conv, double eps_fusions, bool scale, bool save_clusterpath, bool use_target, bool save_losses, bool save_convergence_norms, int burnin_iter, int max_iter_conv, int n_threads, int acceleration, int history, const std::string& sink_path, bool instrumentation, bool single_precision);
+RcppExport SEXP _CCMMR_convex_clusterpath(SEXP XSEXP, SEXP W_idxSEXP, SEXP W_valSEXP, SEXP lambdasSEXP, SEXP target_lossesSEXP, SEXP eps_convSEXP, SEXP eps_fusionsSEXP, SEXP scaleSEXP, SEXP save_clusterpathSEXP, SEXP use_targetSEXP, SEXP save_lossesSEXP, SEXP save_convergence_normsSEXP, SEXP burnin_iterSEXP, SEXP max_iter_convSEXP, SEXP n_threadsSEXP, SEXP accelerationSEXP, SEXP historySEXP, SEXP sink_pathSEXP, SEXP instrumentationSEXP, SEXP single_precisionSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type X(XSEXP);
     Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type W_idx(W_idxSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type W_val(W_valSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type lambdas(lambdasSEXP);
@@ -31,17 +58,23 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type save_convergence_norms(save_convergence_normsSEXP);
     Rcpp::traits::input_parameter< int >::type burnin_iter(burnin_iterSEXP);
     Rcpp::traits::input_parameter< int >::type max_iter_conv(max_iter_convSEXP);
-    rcpp_result_gen = Rcpp::wrap(convex_clusterpath(X, W_idx, W_val, lambdas, target_losses, eps_conv, eps_fusions, scale, save_clusterpath, use_target, save_losses, save_convergence_norms, burnin_iter, max_iter_conv));
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type acceleration(accelerationSEXP);
+    Rcpp::traits::input_parameter< int >::type history(historySEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type sink_path(sink_pathSEXP);
+    Rcpp::traits::input_parameter< bool >::type instrumentation(instrumentationSEXP);
+    Rcpp::traits::input_parameter< bool >::type single_precision(single_precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(convex_clusterpath(X, W_idx, W_val, lambdas, target_losses, eps_conv, eps_fusions, scale, save_clusterpath, use_target, save_losses, save_convergence_norms, burnin_iter, max_iter_conv, n_threads, acceleration, history, sink_path, instrumentation, single_precision));
     return rcpp_result_gen;
 END_RCPP
 }
 // convex_clustering
-Rcpp::List convex_clustering(const Eigen::MatrixXd& X, const Eigen::MatrixXi& W_idx, const Eigen::VectorXd& W_val, double eps_conv, double eps_fusions, bool scale, bool save_clusterpath, int burnin_iter, int max_iter_conv, int target_low, int target_high, int max_iter_phase_1, int max_iter_phase_2, int verbose, double lambda_init, double factor);
-RcppExport SEXP _CCMMR_convex_clustering(SEXP XSEXP, SEXP W_idxSEXP, SEXP W_valSEXP, SEXP eps_convSEXP, SEXP eps_fusionsSEXP, SEXP scaleSEXP, SEXP save_clusterpathSEXP, SEXP burnin_iterSEXP, SEXP max_iter_convSEXP, SEXP target_lowSEXP, SEXP target_highSEXP, SEXP max_iter_phase_1SEXP, SEXP max_iter_phase_2SEXP, SEXP verboseSEXP, SEXP lambda_initSEXP, SEXP factorSEXP) {
+Rcpp::List convex_clustering(const Eigen::Map<Eigen::MatrixXd> X, const Eigen::MatrixXi& W_idx, const Eigen::VectorXd& W_val, double eps_conv, double eps_fusions, bool scale, bool save_clusterpath, int burnin_iter, int max_iter_conv, int target_low, int target_high, int max_iter_phase_1, int max_iter_phase_2, int verbose, double lambda_init, double factor, int n_threads, int acceleration, int history, int n_probes, bool instrumentation, bool single_precision);
+RcppExport SEXP _CCMMR_convex_clustering(SEXP XSEXP, SEXP W_idxSEXP, SEXP W_valSEXP, SEXP eps_convSEXP, SEXP eps_fusionsSEXP, SEXP scaleSEXP, SEXP save_clusterpathSEXP, SEXP burnin_iterSEXP, SEXP max_iter_convSEXP, SEXP target_lowSEXP, SEXP target_highSEXP, SEXP max_iter_phase_1SEXP, SEXP max_iter_phase_2SEXP, SEXP verboseSEXP, SEXP lambda_initSEXP, SEXP factorSEXP, SEXP n_threadsSEXP, SEXP accelerationSEXP, SEXP historySEXP, SEXP n_probesSEXP, SEXP instrumentationSEXP, SEXP single_precisionSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type X(XSEXP);
     Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type W_idx(W_idxSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type W_val(W_valSEXP);
     Rcpp::traits::input_parameter< double >::type eps_conv(eps_convSEXP);
@@ -57,19 +90,29 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type verbose(verboseSEXP);
     Rcpp::traits::input_parameter< double >::type lambda_init(lambda_initSEXP);
     Rcpp::traits::input_parameter< double >::type factor(factorSEXP);
-    rcpp_result_gen = Rcpp::wrap(convex_clustering(X, W_idx, W_val, eps_conv, eps_fusions, scale, save_clusterpath, burnin_iter, max_iter_conv, target_low, target_high, max_iter_phase_1, max_iter_phase_2, verbose, lambda_init, factor));
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type acceleration(accelerationSEXP);
+    Rcpp::traits::input_parameter< int >::type history(historySEXP);
+    Rcpp::traits::input_parameter< int >::type n_probes(n_probesSEXP);
+    Rcpp::traits::input_parameter< bool >::type instrumentation(instrumentationSEXP);
+    Rcpp::traits::input_parameter< bool >::type single_precision(single_precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(convex_clustering(X, W_idx, W_val, eps_conv, eps_fusions, scale, save_clusterpath, burnin_iter, max_iter_conv, target_low, target_high, max_iter_phase_1, max_iter_phase_2, verbose, lambda_init, factor, n_threads, acceleration, history, n_probes, instrumentation, single_precision));
     return rcpp_result_gen;
 END_RCPP
 }
 // fusion_threshold
-double fusion_threshold(const Eigen::MatrixXd X, const double tau);
-RcppExport SEXP _CCMMR_fusion_threshold(SEXP XSEXP, SEXP tauSEXP) {
+double fusion_threshold(const Eigen::MatrixXd X, const double tau, const bool exact, const double error, const int seed, const int n_threads);
+RcppExport SEXP _CCMMR_fusion_threshold(SEXP XSEXP, SEXP tauSEXP, SEXP exactSEXP, SEXP errorSEXP, SEXP seedSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const Eigen::MatrixXd >::type X(XSEXP);
     Rcpp::traits::input_parameter< const double >::type tau(tauSEXP);
-    rcpp_result_gen = Rcpp::wrap(fusion_threshold(X, tau));
+    Rcpp::traits::input_parameter< const bool >::type exact(exactSEXP);
+    Rcpp::traits::input_parameter< const double >::type error(errorSEXP);
+    Rcpp::traits::input_parameter< const int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(fusion_threshold(X, tau, exact, error, seed, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -84,21 +127,48 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// find_mst_sparse
+Eigen::MatrixXi find_mst_sparse(const Eigen::MatrixXi& E, const Eigen::VectorXd& w, int n);
+RcppExport SEXP _CCMMR_find_mst_sparse(SEXP ESEXP, SEXP wSEXP, SEXP nSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type E(ESEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type w(wSEXP);
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    rcpp_result_gen = Rcpp::wrap(find_mst_sparse(E, w, n));
+    return rcpp_result_gen;
+END_RCPP
+}
 // find_subgraphs
-Eigen::VectorXi find_subgraphs(const Eigen::MatrixXi& E, int n);
-RcppExport SEXP _CCMMR_find_subgraphs(SEXP ESEXP, SEXP nSEXP) {
+Eigen::VectorXi find_subgraphs(const Eigen::MatrixXi& E, int n, int n_threads);
+RcppExport SEXP _CCMMR_find_subgraphs(SEXP ESEXP, SEXP nSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type E(ESEXP);
     Rcpp::traits::input_parameter< int >::type n(nSEXP);
-    rcpp_result_gen = Rcpp::wrap(find_subgraphs(E, n));
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(find_subgraphs(E, n, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// connect_subgraphs
+Rcpp::List connect_subgraphs(const Eigen::MatrixXd& X, const Eigen::MatrixXi& E, int n_threads);
+RcppExport SEXP _CCMMR_connect_subgraphs(SEXP XSEXP, SEXP ESEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type E(ESEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(connect_subgraphs(X, E, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // sparse_weights
-Rcpp::List sparse_weights(const Eigen::MatrixXd& X, const Eigen::MatrixXi& indices, const Eigen::MatrixXd& distances, const double phi, const int k, const bool sym_circ, const bool scale);
-RcppExport SEXP _CCMMR_sparse_weights(SEXP XSEXP, SEXP indicesSEXP, SEXP distancesSEXP, SEXP phiSEXP, SEXP kSEXP, SEXP sym_circSEXP, SEXP scaleSEXP) {
+Rcpp::List sparse_weights(const Eigen::MatrixXd& X, const Eigen::MatrixXi& indices, const Eigen::MatrixXd& distances, const double phi, const int k, const bool sym_circ, const bool scale, const int n_threads);
+RcppExport SEXP _CCMMR_sparse_weights(SEXP XSEXP, SEXP indicesSEXP, SEXP distancesSEXP, SEXP phiSEXP, SEXP kSEXP, SEXP sym_circSEXP, SEXP scaleSEXP, SEXP n_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -109,18 +179,40 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const int >::type k(kSEXP);
     Rcpp::traits::input_parameter< const bool >::type sym_circ(sym_circSEXP);
     Rcpp::traits::input_parameter< const bool >::type scale(scaleSEXP);
-    rcpp_result_gen = Rcpp::wrap(sparse_weights(X, indices, distances, phi, k, sym_circ, scale));
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sparse_weights(X, indices, distances, phi, k, sym_circ, scale, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sparse_weights_native
+Rcpp::List sparse_weights_native(const Eigen::MatrixXd& X, const double phi, const int k, const bool sym_circ, const bool scale, const int n_threads);
+RcppExport SEXP _CCMMR_sparse_weights_native(SEXP XSEXP, SEXP phiSEXP, SEXP kSEXP, SEXP sym_circSEXP, SEXP scaleSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< const double >::type phi(phiSEXP);
+    Rcpp::traits::input_parameter< const int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sym_circ(sym_circSEXP);
+    Rcpp::traits::input_parameter< const bool >::type scale(scaleSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sparse_weights_native(X, phi, k, sym_circ, scale, n_threads));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_CCMMR_convex_clusterpath", (DL_FUNC) &_CCMMR_convex_clusterpath, 14},
-    {"_CCMMR_convex_clustering", (DL_FUNC) &_CCMMR_convex_clustering, 16},
-    {"_CCMMR_fusion_threshold", (DL_FUNC) &_CCMMR_fusion_threshold, 2},
+    {"_CCMMR_expand_clusterpath", (DL_FUNC) &_CCMMR_expand_clusterpath, 4},
+    {"_CCMMR_cut_clusterpath", (DL_FUNC) &_CCMMR_cut_clusterpath, 3},
+    {"_CCMMR_convex_clusterpath", (DL_FUNC) &_CCMMR_convex_clusterpath, 20},
+    {"_CCMMR_convex_clustering", (DL_FUNC) &_CCMMR_convex_clustering, 22},
+    {"_CCMMR_fusion_threshold", (DL_FUNC) &_CCMMR_fusion_threshold, 6},
     {"_CCMMR_find_mst", (DL_FUNC) &_CCMMR_find_mst, 1},
-    {"_CCMMR_find_subgraphs", (DL_FUNC) &_CCMMR_find_subgraphs, 2},
-    {"_CCMMR_sparse_weights", (DL_FUNC) &_CCMMR_sparse_weights, 7},
+    {"_CCMMR_find_mst_sparse", (DL_FUNC) &_CCMMR_find_mst_sparse, 3},
+    {"_CCMMR_find_subgraphs", (DL_FUNC) &_CCMMR_find_subgraphs, 3},
+    {"_CCMMR_connect_subgraphs", (DL_FUNC) &_CCMMR_connect_subgraphs, 3},
+    {"_CCMMR_sparse_weights", (DL_FUNC) &_CCMMR_sparse_weights, 8},
+    {"_CCMMR_sparse_weights_native", (DL_FUNC) &_CCMMR_sparse_weights_native, 6},
     {NULL, NULL, 0}
 };
 
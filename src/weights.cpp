@@ -1,7 +1,7 @@
 //[[Rcpp::depends(RcppEigen)]]
 
 #include <RcppEigen.h>
-#include <Eigen/Dense>
+#include <ccmmr/weights.h>
 
 
 //[[Rcpp::export(.sparse_weights)]]
@@ -11,79 +11,39 @@ Rcpp::List sparse_weights(const Eigen::MatrixXd& X,
                           const double phi,
                           const int k,
                           const bool sym_circ,
-                          const bool scale)
+                          const bool scale,
+                          const int n_threads)
 {
-    // Preliminaries
-    int n = int(X.cols());
+    CCMMWeights weights = knn_weights(X, indices, distances, phi, k, sym_circ,
+                                      scale, n_threads);
 
-    // Array of keys and values, 2*(k+2)*n is a loose upper bound on the number
-    // of nonzero weights, trimming happens later
-    Eigen::ArrayXXi keys(2, 2 * (k + 2) * n);
-    Eigen::ArrayXd values(2 * (k + 2) * n);
-
-    // Fill keys
-    int key_count = 0;
-    for (int i = 0; i < indices.cols(); i++) {
-        for (int j = 0; j < indices.rows(); j++) {
-            if (i != indices(j, i)) {
-                keys(0, key_count) = i;
-                keys(1, key_count) = indices(j, i);
-                keys(0, key_count + 1) = indices(j, i);
-                keys(1, key_count + 1) = i;
-
-                values(key_count) = distances(j, i);
-                values(key_count + 1) = distances(j, i);
-
-                key_count += 2;
-            }
-        }
-    }
-
-    // Apply symmetric circulant
-    if (sym_circ) {
-        for (int i = 0; i < n; i++) {
-            int j = (i + 1) % n;
-            double d_ij = (X.col(i) - X.col(j)).norm();
-
-            keys(0, key_count) = i;
-            keys(1, key_count) = j;
-            keys(0, key_count + 1) = j;
-            keys(1, key_count + 1) = i;
-
-            values(key_count) = d_ij;
-            values(key_count + 1) = d_ij;
-
-            key_count += 2;
-        }
-    }
+    // Return result as a list with all relevant variables
+    Rcpp::List res = Rcpp::List::create(
+        Rcpp::Named("keys") = weights.keys,
+        Rcpp::Named("values") = weights.values,
+        Rcpp::Named("msd") = weights.msd
+    );
 
-    // Trim unused key/value pairs
-    keys.conservativeResize(2, key_count);
-    values.conservativeResize(key_count);
+    return res;
+}
 
-    // Compute mean squared distance
-    double msd = 0;
-    if (scale) {
-        for (int j = 0; j < n; j++) {
-            for (int i = j + 1; i < n; i++) {
-                msd += (X.col(j) - X.col(i)).squaredNorm();
-            }
-        }
-        msd /= (n * (n - 1) / 2);
-    }
 
-    // Compute weights
-    values = values.square();
-    if (scale) {
-        values /= msd;
-    }
-    values = Eigen::exp(-phi * values);
+//[[Rcpp::export(.sparse_weights_native)]]
+Rcpp::List sparse_weights_native(const Eigen::MatrixXd& X,
+                                 const double phi,
+                                 const int k,
+                                 const bool sym_circ,
+                                 const bool scale,
+                                 const int n_threads)
+{
+    CCMMWeights weights = native_knn_weights(X, phi, k, sym_circ, scale,
+                                             n_threads);
 
     // Return result as a list with all relevant variables
     Rcpp::List res = Rcpp::List::create(
-        Rcpp::Named("keys") = keys,
-        Rcpp::Named("values") = values,
-        Rcpp::Named("msd") = msd
+        Rcpp::Named("keys") = weights.keys,
+        Rcpp::Named("values") = weights.values,
+        Rcpp::Named("msd") = weights.msd
     );
 
     return res;